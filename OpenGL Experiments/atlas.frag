@@ -0,0 +1,17 @@
+#version 330 core
+
+out vec4 outputColor;
+
+//Every texture in the scene lives somewhere in this array
+uniform sampler2DArray samp;
+
+//Declare VS_OUT as an input interface block
+in VS_OUT {
+    vec3 color;
+    vec2 uv;
+    flat float layer;
+} fs_in;
+
+void main() {
+    outputColor = texture(samp, vec3(fs_in.uv, fs_in.layer));
+}
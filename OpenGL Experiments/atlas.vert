@@ -0,0 +1,43 @@
+#version 330 core
+
+//The location corresponds to the value passed into the corresponding calls to glVertexAttribPointer
+layout(location = 0) in vec3 in_pos;
+layout(location = 1) in vec3 in_col;
+layout(location = 2) in float in_layer;
+layout(location = 3) in vec2 in_uv;
+
+//Shared by every program and uploaded once per frame (see uniformbuffers.h)
+layout(std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+} camera;
+
+//Per-object data: draws of the same mesh are instanced, and gl_InstanceID picks the object
+struct ObjectData {
+    mat4 model;
+};
+
+layout(std140) uniform Objects {
+    ObjectData objects[256];
+};
+
+//Declare VS_OUT as an output interface block
+out VS_OUT {
+    vec3 color;
+    vec2 uv;
+    flat float layer;
+} vs_out;
+
+void main() {
+    //Simply pass the color to the fragment shader
+    vs_out.color = in_col;
+    
+    //The UVs were already moved into the texture's spot in the atlas, the layer picks the page
+    vs_out.uv = in_uv;
+    vs_out.layer = in_layer;
+    
+    //Output the position
+    gl_Position = camera.viewProjection * objects[gl_InstanceID].model * vec4(in_pos, 1.0);
+}
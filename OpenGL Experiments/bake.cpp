@@ -0,0 +1,648 @@
+//bake: converts an asset directory into the binary formats the renderer loads at runtime
+//  OBJ  -> .mesh (indexed and clustered, see meshcache.h)
+//  BMP  -> .tex  (full mip chain, see texturecache.h)
+//  GLSL -> validated by compiling it in a hidden GL context, then copied
+//Usage: bake <asset directory> <output directory> [-j threads] [-f]
+//
+//Every source is hashed (FNV-1a) together with the files it depends on and the version of the format it is baked to
+//The hashes are kept in <output directory>/bake.manifest, so a second run only rebuilds what actually changed
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "shaderloader.h"
+#include "memory.h"
+#include "bmploader.h"
+#include "meshcache.h"
+#include "texturecache.h"
+
+//Bump this whenever a change to the tool itself should invalidate everything it has baked
+#define BAKE_VERSION 1
+
+using namespace std;
+
+typedef unsigned long long hash64;
+
+enum assetType {
+    ASSET_MESH,
+    ASSET_TEXTURE,
+    ASSET_SHADER
+};
+
+//What the manifest remembers about a file: size and modification time let an unchanged file skip being hashed again
+struct fileRecord {
+    long long       size;
+    long long       modified;
+    hash64          hash;
+};
+
+//What the manifest remembers about a baked asset
+struct assetRecord {
+    hash64          key;
+    vector<string>  dependencies;
+};
+
+struct manifest {
+    map<string, fileRecord>     files;
+    map<string, assetRecord>    assets;
+};
+
+enum bakeResult {
+    BAKE_UP_TO_DATE,
+    BAKE_BUILT,
+    BAKE_COPIED,        //Written but not validated (a shader newer than the context's GLSL), so it is checked again next run
+    BAKE_FAILED
+};
+
+//One source file; paths are relative to the asset / output directories
+struct bakeJob {
+    string          source;
+    string          output;
+    assetType       type;
+    bakeResult      result;
+    double          milliseconds;
+    size_t          bytes;
+
+    //Filled in by whichever thread runs the job and merged into the new manifest afterwards
+    assetRecord                 record;
+    map<string, fileRecord>     files;
+};
+
+/*
+ *
+ * Hashing
+ *
+ */
+
+static const hash64 FNV_OFFSET_BASIS = 14695981039346656037ULL;
+static const hash64 FNV_PRIME = 1099511628211ULL;
+
+static hash64 fnv1a(const void *data, size_t size, hash64 hash = FNV_OFFSET_BASIS) {
+    const unsigned char *bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static bool readFile(const string &path, vector<char> &out_data) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == NULL) {
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    out_data.resize(size > 0 ? size : 0);
+    bool success = out_data.empty() || fread(&out_data[0], 1, out_data.size(), file) == out_data.size();
+    fclose(file);
+    return success;
+}
+
+//Hashes a file, reusing the previous hash if the manifest says it hasn't been touched since
+//If the file had to be read and out_data is given, its contents are handed back; out_data is left empty otherwise
+static bool hashFile(const string &root, const string &path, const manifest &previous, fileRecord &out_record, vector<char> *out_data) {
+    struct stat fileStat;
+    if (stat((root + "/" + path).c_str(), &fileStat) != 0) {
+        return false;
+    }
+    out_record.size = fileStat.st_size;
+    out_record.modified = fileStat.st_mtime;
+
+    map<string, fileRecord>::const_iterator known = previous.files.find(path);
+    if (known != previous.files.end() &&
+        known->second.size == out_record.size && known->second.modified == out_record.modified) {
+        out_record.hash = known->second.hash;
+        return true;
+    }
+
+    vector<char> data;
+    vector<char> &contents = out_data != NULL ? *out_data : data;
+    if (!readFile(root + "/" + path, contents)) {
+        return false;
+    }
+    out_record.hash = fnv1a(contents.empty() ? NULL : &contents[0], contents.size());
+    return true;
+}
+
+/*
+ *
+ * Paths
+ *
+ */
+
+static string getDirectory(const string &path) {
+    size_t slash = path.rfind('/');
+    return slash == string::npos ? string() : path.substr(0, slash);
+}
+
+static string joinPath(const string &directory, const string &name) {
+    return directory.empty() ? name : directory + "/" + name;
+}
+
+static string getExtension(const string &path) {
+    size_t dot = path.rfind('.');
+    if (dot == string::npos || path.find('/', dot) != string::npos) {
+        return string();
+    }
+    string extension = path.substr(dot);
+    transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension;
+}
+
+static string replaceExtension(const string &path, const char *extension) {
+    size_t dot = path.rfind('.');
+    return path.substr(0, dot) + extension;
+}
+
+//mkdir -p
+static bool makeDirectories(const string &path) {
+    if (path.empty()) {
+        return true;
+    }
+    struct stat dirStat;
+    if (stat(path.c_str(), &dirStat) == 0) {
+        return S_ISDIR(dirStat.st_mode);
+    }
+    if (!makeDirectories(getDirectory(path))) {
+        return false;
+    }
+    return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+static bool fileExists(const string &path) {
+    struct stat fileStat;
+    return stat(path.c_str(), &fileStat) == 0;
+}
+
+//A texture cache with a header that doesn't match its file is rebuilt rather than trusted, whatever the manifest says
+static bool isOutputUsable(const bakeJob &job, const string &outputPath) {
+    if (job.type != ASSET_TEXTURE) {
+        return fileExists(outputPath);
+    }
+    textureCacheHeader header;
+    FILE *file = openTextureCache(outputPath.c_str(), header);
+    if (file == NULL) {
+        return false;
+    }
+    fclose(file);
+    return true;
+}
+
+//Collects every asset below the root, skipping hidden entries and the output directory itself
+//The output directory is recognised by device and inode, so it is skipped however its path was spelled
+static void findAssets(const string &root, const string &directory, const struct stat &skip, vector<bakeJob> &out_jobs) {
+    string fullPath = directory.empty() ? root : root + "/" + directory;
+    DIR *dir = opendir(fullPath.c_str());
+    if (dir == NULL) {
+        cerr << "Failed to open directory " << fullPath << "." << endl;
+        return;
+    }
+    vector<string> names;
+    while (dirent *entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') {
+            names.push_back(entry->d_name);
+        }
+    }
+    closedir(dir);
+
+    //Sorted, so that the job order (and the report) doesn't depend on the file system
+    sort(names.begin(), names.end());
+    for (size_t i = 0; i < names.size(); i++) {
+        string path = joinPath(directory, names[i]);
+        struct stat entryStat;
+        if (stat((root + "/" + path).c_str(), &entryStat) != 0) {
+            continue;
+        }
+        if (S_ISDIR(entryStat.st_mode)) {
+            if (entryStat.st_dev != skip.st_dev || entryStat.st_ino != skip.st_ino) {
+                findAssets(root, path, skip, out_jobs);
+            }
+            continue;
+        }
+
+        bakeJob job;
+        job.source = path;
+        job.result = BAKE_UP_TO_DATE;
+        job.milliseconds = 0.0;
+        job.bytes = 0;
+        job.record.key = 0;
+        string extension = getExtension(path);
+        if (extension == ".obj") {
+            job.type = ASSET_MESH;
+            job.output = replaceExtension(path, ".mesh");
+        }
+        else if (extension == ".bmp") {
+            job.type = ASSET_TEXTURE;
+            job.output = replaceExtension(path, ".tex");
+        }
+        else if (extension == ".vert" || extension == ".frag" || extension == ".geom" || extension == ".comp") {
+            job.type = ASSET_SHADER;
+            job.output = path;
+        }
+        else {
+            continue;
+        }
+        out_jobs.push_back(job);
+    }
+}
+
+/*
+ *
+ * Manifest
+ *
+ */
+
+//One record per line, fields separated by tabs (paths can contain spaces):
+//  file    <size> <modified> <hash> <path>
+//  asset   <key> <output> <dependency>...
+static void splitTabs(const string &line, vector<string> &out_fields) {
+    out_fields.clear();
+    size_t start = 0;
+    for (size_t tab = line.find('\t'); tab != string::npos; tab = line.find('\t', start)) {
+        out_fields.push_back(line.substr(start, tab - start));
+        start = tab + 1;
+    }
+    out_fields.push_back(line.substr(start));
+}
+
+static void loadManifest(const string &path, manifest &out_manifest) {
+    ifstream stream(path.c_str());
+    string line;
+    vector<string> fields;
+    while (getline(stream, line)) {
+        splitTabs(line, fields);
+        if (fields[0] == "file" && fields.size() == 5) {
+            fileRecord record;
+            record.size = strtoll(fields[1].c_str(), NULL, 10);
+            record.modified = strtoll(fields[2].c_str(), NULL, 10);
+            record.hash = strtoull(fields[3].c_str(), NULL, 16);
+            out_manifest.files[fields[4]] = record;
+        }
+        else if (fields[0] == "asset" && fields.size() >= 3) {
+            assetRecord &record = out_manifest.assets[fields[2]];
+            record.key = strtoull(fields[1].c_str(), NULL, 16);
+            record.dependencies.assign(fields.begin() + 3, fields.end());
+        }
+    }
+}
+
+static bool saveManifest(const string &path, const manifest &current) {
+    //Write to the side and rename, so an interrupted bake never leaves a half-written manifest behind
+    string temporaryPath = path + ".tmp";
+    FILE *file = fopen(temporaryPath.c_str(), "w");
+    if (file == NULL) {
+        cerr << "Failed to write manifest " << path << "." << endl;
+        return false;
+    }
+    for (map<string, fileRecord>::const_iterator it = current.files.begin(); it != current.files.end(); ++it) {
+        fprintf(file, "file\t%lld\t%lld\t%016llx\t%s\n", it->second.size, it->second.modified, it->second.hash, it->first.c_str());
+    }
+    for (map<string, assetRecord>::const_iterator it = current.assets.begin(); it != current.assets.end(); ++it) {
+        fprintf(file, "asset\t%016llx\t%s", it->second.key, it->first.c_str());
+        for (size_t i = 0; i < it->second.dependencies.size(); i++) {
+            fprintf(file, "\t%s", it->second.dependencies[i].c_str());
+        }
+        fprintf(file, "\n");
+    }
+    fclose(file);
+    return rename(temporaryPath.c_str(), path.c_str()) == 0;
+}
+
+/*
+ *
+ * Baking
+ *
+ */
+
+struct bakeContext {
+    string          sourceRoot;
+    string          outputRoot;
+    manifest        previous;
+    bool            force;
+
+    //The GLSL version of the hidden context (e.g. 150 or 430); shaders that ask for more are copied without being compiled
+    int             glslVersion;
+};
+
+//The number on a shader's #version line; GLSL without one is version 110
+static int getShaderVersion(const vector<char> &source) {
+    string text(source.begin(), source.end());
+    size_t directive = text.find("#version");
+    if (directive == string::npos) {
+        return 110;
+    }
+    return atoi(text.c_str() + directive + 8);
+}
+
+//Material libraries are the only files an OBJ pulls in
+static void findObjDependencies(const string &objPath, const vector<char> &contents, vector<string> &out_dependencies) {
+    string text(contents.begin(), contents.end());
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == string::npos) {
+            end = text.size();
+        }
+        if (text.compare(start, 7, "mtllib ") == 0) {
+            string name = text.substr(start + 7, end - start - 7);
+            while (!name.empty() && (name[name.size() - 1] == '\r' || name[name.size() - 1] == ' ')) {
+                name.erase(name.size() - 1);
+            }
+            string dependency = joinPath(getDirectory(objPath), name);
+            if (find(out_dependencies.begin(), out_dependencies.end(), dependency) == out_dependencies.end()) {
+                out_dependencies.push_back(dependency);
+            }
+        }
+        start = end + 1;
+    }
+}
+
+//Works out the key of the job's inputs and, if it differs from the manifest's, rebuilds the output
+static void runJob(const bakeContext &context, bakeJob &job) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    //Sources whose size or time stamp changed are read here anyway, so OBJs are scanned for dependencies while we have them
+    fileRecord sourceRecord;
+    vector<char> contents;
+    map<string, assetRecord>::const_iterator known = context.previous.assets.find(job.output);
+    if (!hashFile(context.sourceRoot, job.source, context.previous, sourceRecord, &contents)) {
+        cerr << "Failed to read " << job.source << "." << endl;
+        job.result = BAKE_FAILED;
+        return;
+    }
+    map<string, fileRecord>::const_iterator knownSource = context.previous.files.find(job.source);
+    bool sourceChanged = knownSource == context.previous.files.end() || knownSource->second.hash != sourceRecord.hash;
+    if (job.type == ASSET_MESH && (sourceChanged || known == context.previous.assets.end())) {
+        if (contents.empty()) {
+            readFile(context.sourceRoot + "/" + job.source, contents);
+        }
+        findObjDependencies(job.source, contents, job.record.dependencies);
+    }
+    else if (known != context.previous.assets.end()) {
+        job.record.dependencies = known->second.dependencies;
+    }
+    job.files[job.source] = sourceRecord;
+
+    hash64 key = fnv1a(&sourceRecord.hash, sizeof(sourceRecord.hash));
+    int versions[] = { BAKE_VERSION, job.type, MESH_CACHE_VERSION, TEXTURE_CACHE_VERSION };
+    key = fnv1a(versions, sizeof(versions), key);
+    for (size_t i = 0; i < job.record.dependencies.size(); i++) {
+        //A missing dependency hashes to zero; it changes the key as soon as it shows up
+        fileRecord dependencyRecord;
+        dependencyRecord.hash = 0;
+        if (hashFile(context.sourceRoot, job.record.dependencies[i], context.previous, dependencyRecord, NULL)) {
+            job.files[job.record.dependencies[i]] = dependencyRecord;
+        }
+        key = fnv1a(&dependencyRecord.hash, sizeof(dependencyRecord.hash), key);
+    }
+    job.record.key = key;
+
+    string sourcePath = context.sourceRoot + "/" + job.source;
+    string outputPath = context.outputRoot + "/" + job.output;
+    if (!context.force && known != context.previous.assets.end() && known->second.key == key && isOutputUsable(job, outputPath)) {
+        job.result = BAKE_UP_TO_DATE;
+        return;
+    }
+
+    job.bytes = size_t(sourceRecord.size);
+    bool success = makeDirectories(getDirectory(outputPath));
+    bool validated = true;
+    if (success && job.type == ASSET_MESH) {
+        clusteredMesh mesh;
+        success = buildMesh(sourcePath.c_str(), mesh) && saveMeshCache(outputPath.c_str(), mesh);
+    }
+    else if (success && job.type == ASSET_TEXTURE) {
+        arena &scratch = scratchArena();
+        arenaScope scope(scratch);
+        image img;
+        success = decodeBmp(sourcePath.c_str(), scratch, img) && saveTextureCache(outputPath.c_str(), img);
+    }
+    else if (success && job.type == ASSET_SHADER) {
+        GLenum stage = GL_VERTEX_SHADER;
+        string extension = getExtension(job.source);
+        if (extension == ".frag") {
+            stage = GL_FRAGMENT_SHADER;
+        }
+        else if (extension == ".geom") {
+            stage = GL_GEOMETRY_SHADER;
+        }
+        else if (extension == ".comp") {
+            stage = GL_COMPUTE_SHADER;
+        }
+        vector<char> source;
+        success = readFile(sourcePath, source);
+
+        //Compute shaders are core from 4.3 (GLSL 430) on, whatever version they declare
+        int version = getShaderVersion(source);
+        int required = stage == GL_COMPUTE_SHADER ? max(version, 430) : version;
+        if (success && required > context.glslVersion) {
+            validated = false;
+            cerr << job.source << " needs GLSL " << required << " but the context only has " << context.glslVersion << ": copied without being compiled." << endl;
+        }
+        else if (success) {
+            GLuint shader = compileShader(stage, sourcePath.c_str());
+            success = shader != 0;
+            glDeleteShader(shader);
+        }
+
+        //There is no portable binary format for GLSL, so the runtime format is the validated source
+        if (success) {
+            FILE *file = fopen(outputPath.c_str(), "wb");
+            success = file != NULL && (source.empty() || fwrite(&source[0], 1, source.size(), file) == source.size());
+            if (file != NULL) {
+                fclose(file);
+            }
+        }
+    }
+    job.result = !success ? BAKE_FAILED : validated ? BAKE_BUILT : BAKE_COPIED;
+    job.milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+//Takes jobs off the shared counter until there are none left
+//Each worker gets its own scratch arena, since the loaders take their temporary memory from scratchArena()
+static void runWorker(const bakeContext &context, vector<bakeJob*> &jobs, atomic<size_t> &next) {
+    arena scratch(16 << 20, MEMORY_LOADER);
+    setThreadScratchArena(&scratch);
+    for (size_t i = next++; i < jobs.size(); i = next++) {
+        runJob(context, *jobs[i]);
+    }
+    setThreadScratchArena(NULL);
+}
+
+//Shader compilation needs a context, so the shaders are validated on the main thread in an invisible window
+//Try for 4.3 (compute shaders) first and fall back to the 3.2 core profile the renderer itself asks for
+static GLFWwindow* createHiddenContext(int &out_glslVersion) {
+    if (!glfwInit()) {
+        return NULL;
+    }
+    int versions[][2] = { { 4, 3 }, { 3, 2 } };
+    for (int i = 0; i < 2; i++) {
+        glfwDefaultWindowHints();
+        glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, versions[i][0]);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, versions[i][1]);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        GLFWwindow *window = glfwCreateWindow(1, 1, "bake", NULL, NULL);
+        if (window != NULL) {
+            glfwMakeContextCurrent(window);
+            glewExperimental = GL_TRUE;
+            if (glewInit() != GLEW_OK) {
+                glfwDestroyWindow(window);
+                return NULL;
+            }
+
+            //"4.30 ..." becomes 430
+            int major = 0, minor = 0;
+            const char *version = reinterpret_cast<const char*>(glGetString(GL_SHADING_LANGUAGE_VERSION));
+            if (version == NULL || sscanf(version, "%d.%d", &major, &minor) != 2) {
+                major = 1;
+                minor = 10;
+            }
+            out_glslVersion = major * 100 + minor;
+            return window;
+        }
+    }
+    return NULL;
+}
+
+static void printUsage() {
+    cerr << "Usage: bake <asset directory> <output directory> [-j threads] [-f]" << endl;
+    cerr << "  -j  number of worker threads (defaults to one per core)" << endl;
+    cerr << "  -f  rebuild everything, ignoring the manifest" << endl;
+}
+
+int main(int argc, char *argv[]) {
+    bakeContext context;
+    context.force = false;
+    context.glslVersion = 0;
+    unsigned int threadCount = thread::hardware_concurrency();
+    vector<string> directories;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0) {
+            context.force = true;
+        }
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threadCount = (unsigned int)atoi(argv[++i]);
+        }
+        else {
+            directories.push_back(argv[i]);
+        }
+    }
+    if (directories.size() != 2) {
+        printUsage();
+        return -1;
+    }
+    context.sourceRoot = directories[0];
+    context.outputRoot = directories[1];
+    while (context.sourceRoot.size() > 1 && context.sourceRoot[context.sourceRoot.size() - 1] == '/') {
+        context.sourceRoot.erase(context.sourceRoot.size() - 1);
+    }
+    while (context.outputRoot.size() > 1 && context.outputRoot[context.outputRoot.size() - 1] == '/') {
+        context.outputRoot.erase(context.outputRoot.size() - 1);
+    }
+    if (threadCount == 0) {
+        threadCount = 1;
+    }
+    if (!makeDirectories(context.outputRoot)) {
+        cerr << "Failed to create output directory " << context.outputRoot << "." << endl;
+        return -1;
+    }
+
+    string manifestPath = context.outputRoot + "/bake.manifest";
+    loadManifest(manifestPath, context.previous);
+
+    struct stat outputStat;
+    if (stat(context.outputRoot.c_str(), &outputStat) != 0) {
+        cerr << "Failed to open output directory " << context.outputRoot << "." << endl;
+        return -1;
+    }
+    vector<bakeJob> jobs;
+    findAssets(context.sourceRoot, string(), outputStat, jobs);
+
+    //Meshes and textures go to the workers; shaders stay on the main thread, which owns the GL context
+    vector<bakeJob*> workerJobs;
+    vector<bakeJob*> shaderJobs;
+    for (size_t i = 0; i < jobs.size(); i++) {
+        (jobs[i].type == ASSET_SHADER ? shaderJobs : workerJobs).push_back(&jobs[i]);
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    atomic<size_t> next(0);
+    vector<thread> workers;
+    for (unsigned int i = 0; i < threadCount && i < workerJobs.size(); i++) {
+        workers.push_back(thread(runWorker, cref(context), ref(workerJobs), ref(next)));
+    }
+
+    if (!shaderJobs.empty()) {
+        GLFWwindow *window = createHiddenContext(context.glslVersion);
+        if (window == NULL) {
+            cerr << "Failed to create an OpenGL context: shaders can't be validated." << endl;
+            for (size_t i = 0; i < shaderJobs.size(); i++) {
+                shaderJobs[i]->result = BAKE_FAILED;
+            }
+        }
+        else {
+            for (size_t i = 0; i < shaderJobs.size(); i++) {
+                runJob(context, *shaderJobs[i]);
+            }
+            glfwDestroyWindow(window);
+        }
+        glfwTerminate();
+    }
+
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    //Failed and unvalidated assets are left out of the new manifest so they are retried next time
+    manifest current;
+    size_t built = 0, upToDate = 0, failed = 0, bytes = 0;
+    printf("%-8s %10s %10s  %s\n", "result", "ms", "KB", "asset");
+    for (size_t i = 0; i < jobs.size(); i++) {
+        const bakeJob &job = jobs[i];
+        if (job.result == BAKE_UP_TO_DATE) {
+            upToDate++;
+        }
+        else {
+            const char *result = job.result == BAKE_BUILT ? "built" : job.result == BAKE_COPIED ? "copied" : "FAILED";
+            printf("%-8s %10.1f %10.1f  %s\n", result, job.milliseconds, job.bytes / 1024.0, job.source.c_str());
+            if (job.result == BAKE_BUILT || job.result == BAKE_COPIED) {
+                built++;
+                bytes += job.bytes;
+                if (job.result == BAKE_COPIED) {
+                    continue;
+                }
+            }
+            else {
+                failed++;
+                continue;
+            }
+        }
+        current.assets[job.output] = job.record;
+        current.files.insert(job.files.begin(), job.files.end());
+    }
+    saveManifest(manifestPath, current);
+
+    printf("%zu built, %zu up to date, %zu failed in %.2f s with %u threads\n", built, upToDate, failed, seconds, threadCount);
+    if (seconds > 0.0) {
+        printf("Throughput: %.1f assets/s, %.2f MB/s of source data\n", built / seconds, bytes / (1024.0 * 1024.0) / seconds);
+    }
+    memoryTracker::printStats();
+    return failed == 0 ? 0 : 1;
+}
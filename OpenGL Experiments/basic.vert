@@ -5,7 +5,22 @@ layout(location = 0) in vec3 in_pos;
 layout(location = 1) in vec3 in_col;
 layout(location = 3) in vec2 in_uv;
 
-uniform mat4 ModelViewProjection;
+//Shared by every program and uploaded once per frame (see uniformbuffers.h)
+layout(std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+} camera;
+
+//Per-object data: draws of the same mesh are instanced, and gl_InstanceID picks the object
+struct ObjectData {
+    mat4 model;
+};
+
+layout(std140) uniform Objects {
+    ObjectData objects[256];
+};
 
 //Declare VS_OUT as an output interface block
 out VS_OUT {
@@ -22,5 +37,5 @@ void main() {
     vec4 vert = vec4(in_pos, 1.0);
     
     //Output the position
-    gl_Position = ModelViewProjection * vert;
+    gl_Position = camera.viewProjection * objects[gl_InstanceID].model * vert;
 }
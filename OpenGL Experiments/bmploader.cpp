@@ -0,0 +1,138 @@
+#include "bmploader.h"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+bool decodeBmp(const char *filePath, arena &storage, image &out_image) {
+    //BMP files always begin with a 54-byte header
+    unsigned char header[54];
+    
+    //The actual RGB data
+    unsigned char *data;
+    
+    //Ensure that the file was successfully opened
+    FILE *file = fopen(filePath, "rb");
+    if (!file) {
+        cerr << "Image file could not be opened." << endl;
+        return false;
+    }
+    
+    //Ensure that the given file is actually BMP-formatted (has a 54-byte header)
+    if (fread(header, 1, 54, file) != 54) {
+        cerr << "Not the correct file format. Image should be a BMP file." << endl;
+        fclose(file);
+        return false;
+    }
+    
+    //BMP file headers always begin with 'B' and 'M'
+    if (header[0] != 'B' || header[1] != 'M') {
+        cerr << "Not the correct file format. Image should be a BMP file." << endl;
+        fclose(file);
+        return false;
+    }
+    
+    //Read the size of the image, the location of the data in the file, etc.
+    //The header fields aren't aligned, so they are copied out rather than read through a cast pointer
+    unsigned int dataPos;
+    int width, height;
+    unsigned short bitsPerPixel;
+    unsigned int compression;
+    memcpy(&dataPos, &header[0x0A], 4);
+    memcpy(&width, &header[0x12], 4);
+    memcpy(&height, &header[0x16], 4);
+    memcpy(&bitsPerPixel, &header[0x1C], 2);
+    memcpy(&compression, &header[0x1E], 4);
+    if (dataPos == 0) {
+        dataPos = 54;
+    }
+    
+    //Only uncompressed, bottom-up 24-bit files are supported (a negative height means the rows are stored top-down)
+    if (bitsPerPixel != 24 || compression != 0) {
+        cerr << "Only uncompressed 24-bit BMP files are supported: " << filePath << "." << endl;
+        fclose(file);
+        return false;
+    }
+    if (width <= 0 || height <= 0) {
+        cerr << "Unsupported BMP dimensions " << width << "x" << height << " in " << filePath << "." << endl;
+        fclose(file);
+        return false;
+    }
+    
+    //Every row in the file is padded to a multiple of 4 bytes; refuse anything whose size doesn't comfortably fit in memory
+    size_t rowSize = (size_t(width) * 3 + 3) & ~size_t(3);
+    if (rowSize > (size_t(1) << 31) / size_t(height)) {
+        cerr << "BMP file " << filePath << " is too large." << endl;
+        fclose(file);
+        return false;
+    }
+    size_t imageSize = rowSize * height;
+    
+    //Create a buffer
+    data = storage.allocateArray<unsigned char>(imageSize);
+    
+    //Read the actual data from the file into the buffer
+    fseek(file, dataPos, SEEK_SET);
+    if (fread(data, 1, imageSize, file) != imageSize) {
+        cerr << "Image file is truncated." << endl;
+        fclose(file);
+        return false;
+    }
+    
+    //Everything should be in memory now, so close the file
+    fclose(file);
+    
+    //Squeeze the row padding out in place (each row only ever moves towards the start of the buffer)
+    size_t pixelRowSize = size_t(width) * 3;
+    if (rowSize != pixelRowSize) {
+        for (size_t row = 1; row < size_t(height); row++) {
+            memmove(data + row * pixelRowSize, data + row * rowSize, pixelRowSize);
+        }
+    }
+    
+    out_image.width = width;
+    out_image.height = height;
+    out_image.pixels = data;
+    return true;
+}
+
+GLuint uploadTexture(const image &img) {
+    //Create one OpenGL texture
+    GLuint texID;
+    glGenTextures(1, &texID);
+    
+    //"Bind" the newly created texture so that all future texture functions will modify this texture
+    glBindTexture(GL_TEXTURE_2D, texID);
+    
+    //Rows are tightly packed, not padded to 4 bytes
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    
+    //Give the image data to OpenGL
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, img.width, img.height, 0, GL_BGR, GL_UNSIGNED_BYTE, img.pixels);
+
+    //When MAGnifying the image (no bigger mipmap available), use LINEAR filtering
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    //When MINifying the image, use a LINEAR blend of two mipmaps, each filtered LINEARLY too
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    //Generate mipmaps, by the way.
+    glGenerateMipmap(GL_TEXTURE_2D);
+    
+    return texID;
+}
+
+GLuint loadBmp(const char *filePath) {
+    //The pixel data only has to live until it has been handed to OpenGL, so it comes from the scratch arena
+    arena &scratch = scratchArena();
+    arenaScope scope(scratch);
+    
+    image img;
+    if (!decodeBmp(filePath, scratch, img)) {
+        return 0;
+    }
+    GLuint texID = uploadTexture(img);
+    
+    cout << "Successfully loaded a texture from the provided BMP file." << endl;
+    
+    return texID;
+}
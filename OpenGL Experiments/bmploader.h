@@ -0,0 +1,20 @@
+#pragma once
+
+#include <GL/glew.h>
+#include "memory.h"
+
+//Tightly packed 8-bit BGR pixels, bottom row first (the order used by both BMP files and glTexImage2D)
+struct image {
+    int             width;
+    int             height;
+    unsigned char*  pixels;
+};
+
+//Reads an uncompressed, bottom-up 24-bit BMP file (anything else is rejected); the pixels are allocated from the given arena
+bool decodeBmp(const char *filePath, arena &storage, image &out_image);
+
+//Creates a mipmapped GL_TEXTURE_2D from the image
+GLuint uploadTexture(const image &img);
+
+//decodeBmp + uploadTexture, with the pixels only living in the scratch arena until the upload
+GLuint loadBmp(const char *filePath);
@@ -27,6 +27,10 @@ glm::mat4 controls::getViewMatrix() {
     return viewMatrix;
 }
 
+glm::vec3 controls::getPosition() {
+    return position;
+}
+
 glm::mat4 controls::getProjectionMatrix() {
     return projectionMatrix;
 }
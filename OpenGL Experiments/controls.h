@@ -7,6 +7,7 @@ public:
     controls(GLFWwindow* _window);
     glm::mat4       getProjectionMatrix();
     glm::mat4       getViewMatrix();
+    glm::vec3       getPosition();
     void            computeMatricesFromInputs();    
 private:
     GLFWwindow*     window;
@@ -0,0 +1,216 @@
+#include "culling.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+frustum extractFrustum(const glm::mat4 &viewProjection) {
+    //GLM matrices are column-major, so gather the rows first
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    }
+
+    //Left, right, bottom, top, near, far (Gribb & Hartmann)
+    frustum f;
+    f.planes[0] = rows[3] + rows[0];
+    f.planes[1] = rows[3] - rows[0];
+    f.planes[2] = rows[3] + rows[1];
+    f.planes[3] = rows[3] - rows[1];
+    f.planes[4] = rows[3] + rows[2];
+    f.planes[5] = rows[3] - rows[2];
+
+    //Normalize so that the plane equation gives a real distance, which is what the sphere test needs
+    for (int i = 0; i < 6; i++) {
+        float length = glm::length(glm::vec3(f.planes[i].x, f.planes[i].y, f.planes[i].z));
+        f.planes[i] = f.planes[i] / length;
+    }
+    return f;
+}
+
+glm::vec4 computeBoundingSphere(const std::vector<glm::vec3> &points) {
+    if (points.empty()) {
+        return glm::vec4(0.0f);
+    }
+
+    //Center on the bounding box, then grow the radius to reach the farthest point
+    glm::vec3 minimum = points[0];
+    glm::vec3 maximum = points[0];
+    for (size_t i = 1; i < points.size(); i++) {
+        minimum = glm::min(minimum, points[i]);
+        maximum = glm::max(maximum, points[i]);
+    }
+    glm::vec3 center = (minimum + maximum) * 0.5f;
+    float radius = 0.0f;
+    for (size_t i = 0; i < points.size(); i++) {
+        radius = std::max(radius, glm::distance(center, points[i]));
+    }
+    return glm::vec4(center, radius);
+}
+
+glm::vec4 transformBoundingSphere(const glm::vec4 &sphere, const glm::mat4 &model) {
+    glm::vec4 center = model * glm::vec4(sphere.x, sphere.y, sphere.z, 1.0f);
+
+    //Non-uniform scales stretch the sphere, so use the largest axis
+    float scale = std::max(glm::length(glm::vec3(model[0].x, model[0].y, model[0].z)),
+                  std::max(glm::length(glm::vec3(model[1].x, model[1].y, model[1].z)),
+                           glm::length(glm::vec3(model[2].x, model[2].y, model[2].z))));
+    return glm::vec4(center.x, center.y, center.z, sphere.w * scale);
+}
+
+bool sphereInFrustum(const frustum &f, const glm::vec4 &sphere) {
+    for (int i = 0; i < 6; i++) {
+        const glm::vec4 &p = f.planes[i];
+        if (p.x * sphere.x + p.y * sphere.y + p.z * sphere.z + p.w < -sphere.w) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ *
+ * depthPyramid
+ *
+ */
+
+depthPyramid::depthPyramid() {
+    baseWidth = 0;
+    baseHeight = 0;
+}
+
+int depthPyramid::getBaseSize(int depthSize) {
+    int size = 1;
+    while (size * 2 <= depthSize) {
+        size *= 2;
+    }
+    return size;
+}
+
+int depthPyramid::getWidth(int level) const {
+    return std::max(1, baseWidth >> level);
+}
+
+int depthPyramid::getHeight(int level) const {
+    return std::max(1, baseHeight >> level);
+}
+
+float depthPyramid::getTexel(int level, int x, int y) const {
+    int width = getWidth(level);
+    x = std::min(std::max(x, 0), width - 1);
+    y = std::min(std::max(y, 0), getHeight(level) - 1);
+    return texels[levelOffsets[level] + size_t(y) * width + x];
+}
+
+void depthPyramid::build(const float *depth, int depthWidth, int depthHeight) {
+    baseWidth = getBaseSize(depthWidth);
+    baseHeight = getBaseSize(depthHeight);
+
+    //Lay every level out back to back in one array
+    levelOffsets.clear();
+    size_t total = 0;
+    for (int level = 0; ; level++) {
+        levelOffsets.push_back(total);
+        total += size_t(getWidth(level)) * getHeight(level);
+        if (getWidth(level) == 1 && getHeight(level) == 1) {
+            break;
+        }
+    }
+    texels.resize(total);
+
+    //Level 0: every texel covers between one and two depth texels in each direction, so take the farthest of all of them
+    for (int y = 0; y < baseHeight; y++) {
+        int y0 = y * depthHeight / baseHeight;
+        int y1 = ((y + 1) * depthHeight + baseHeight - 1) / baseHeight;
+        for (int x = 0; x < baseWidth; x++) {
+            int x0 = x * depthWidth / baseWidth;
+            int x1 = ((x + 1) * depthWidth + baseWidth - 1) / baseWidth;
+            float farthest = 0.0f;
+            for (int sy = y0; sy < y1; sy++) {
+                for (int sx = x0; sx < x1; sx++) {
+                    farthest = std::max(farthest, depth[size_t(sy) * depthWidth + sx]);
+                }
+            }
+            texels[size_t(y) * baseWidth + x] = farthest;
+        }
+    }
+
+    //The remaining levels are a 2x2 max reduction of the level above
+    for (int level = 1; level < getLevelCount(); level++) {
+        int width = getWidth(level);
+        int height = getHeight(level);
+        float *out = &texels[levelOffsets[level]];
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                out[y * width + x] = std::max(std::max(getTexel(level - 1, 2 * x, 2 * y), getTexel(level - 1, 2 * x + 1, 2 * y)),
+                                              std::max(getTexel(level - 1, 2 * x, 2 * y + 1), getTexel(level - 1, 2 * x + 1, 2 * y + 1)));
+            }
+        }
+    }
+}
+
+bool sphereOccluded(const depthPyramid &pyramid, const glm::mat4 &viewProjection, const glm::vec4 &sphere) {
+    if (pyramid.getLevelCount() == 0) {
+        return false;
+    }
+
+    //Project the corners of the sphere's bounding box to get a screen-space rectangle and the nearest depth
+    glm::vec2 minimum(FLT_MAX), maximum(-FLT_MAX);
+    float nearest = 1.0f;
+    for (int i = 0; i < 8; i++) {
+        glm::vec4 corner(sphere.x + ((i & 1) ? sphere.w : -sphere.w),
+                         sphere.y + ((i & 2) ? sphere.w : -sphere.w),
+                         sphere.z + ((i & 4) ? sphere.w : -sphere.w),
+                         1.0f);
+        glm::vec4 clip = viewProjection * corner;
+
+        //Crosses the near plane: don't try to be clever
+        if (clip.w <= 1e-5f) {
+            return false;
+        }
+        glm::vec2 uv(clip.x / clip.w * 0.5f + 0.5f, clip.y / clip.w * 0.5f + 0.5f);
+        minimum = glm::min(minimum, uv);
+        maximum = glm::max(maximum, uv);
+        nearest = std::min(nearest, clip.z / clip.w * 0.5f + 0.5f);
+    }
+    minimum = glm::max(minimum, glm::vec2(0.0f));
+    maximum = glm::min(maximum, glm::vec2(1.0f));
+    if (minimum.x >= maximum.x || minimum.y >= maximum.y) {
+        return false;
+    }
+
+    //Pick the level at which the rectangle spans about one texel, then check every texel it touches
+    float extent = std::max((maximum.x - minimum.x) * pyramid.getWidth(0), (maximum.y - minimum.y) * pyramid.getHeight(0));
+    int level = std::min(std::max(int(std::ceil(std::log2(std::max(extent, 1.0f)))), 0), pyramid.getLevelCount() - 1);
+    int width = pyramid.getWidth(level);
+    int height = pyramid.getHeight(level);
+    int x0 = std::min(int(minimum.x * width), width - 1);
+    int x1 = std::min(int(maximum.x * width), width - 1);
+    int y0 = std::min(int(minimum.y * height), height - 1);
+    int y1 = std::min(int(maximum.y * height), height - 1);
+    float farthest = 0.0f;
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            farthest = std::max(farthest, pyramid.getTexel(level, x, y));
+        }
+    }
+    return nearest > farthest;
+}
+
+unsigned int cullInstances(const cullParameters &parameters,
+                           const depthPyramid *pyramid,
+                           const std::vector<glm::vec4> &bounds,
+                           const std::vector<drawCommand> &commands,
+                           drawCommand *out_commands) {
+    unsigned int visibleCount = 0;
+    for (size_t i = 0; i < commands.size(); i++) {
+        if (!sphereInFrustum(parameters.viewFrustum, bounds[i])) {
+            continue;
+        }
+        if (parameters.occlusionEnabled && pyramid != NULL &&
+            sphereOccluded(*pyramid, parameters.previousViewProjection, bounds[i])) {
+            continue;
+        }
+        out_commands[visibleCount++] = commands[i];
+    }
+    return visibleCount;
+}
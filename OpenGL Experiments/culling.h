@@ -0,0 +1,63 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+//Same layout as the command structure consumed by glMultiDrawElementsIndirect
+struct drawCommand {
+    unsigned int    count;
+    unsigned int    instanceCount;
+    unsigned int    firstIndex;
+    int             baseVertex;
+    unsigned int    baseInstance;
+};
+
+//The six planes of a view frustum, each stored as (normal, distance) with the normal pointing inwards
+struct frustum {
+    glm::vec4       planes[6];
+};
+
+//Extracts the frustum planes from a (Projection * View) matrix
+frustum extractFrustum(const glm::mat4 &viewProjection);
+
+//A sphere is stored as (center, radius)
+glm::vec4 computeBoundingSphere(const std::vector<glm::vec3> &points);
+glm::vec4 transformBoundingSphere(const glm::vec4 &sphere, const glm::mat4 &model);
+bool sphereInFrustum(const frustum &f, const glm::vec4 &sphere);
+
+//A hierarchical-Z pyramid: every texel holds the farthest depth of the region it covers
+//Level 0 is the largest power of two that fits inside the depth buffer, so every level is an exact halving of the one above it
+class depthPyramid {
+public:
+    depthPyramid();
+    void            build(const float *depth, int depthWidth, int depthHeight);
+    int             getLevelCount() const { return int(levelOffsets.size()); }
+    int             getWidth(int level) const;
+    int             getHeight(int level) const;
+    float           getTexel(int level, int x, int y) const;
+    static int      getBaseSize(int depthSize);
+private:
+    std::vector<float>  texels;
+    std::vector<size_t> levelOffsets;
+    int             baseWidth;
+    int             baseHeight;
+};
+
+//Returns true if the sphere is definitely hidden behind the depth stored in the pyramid
+//The pyramid is from the previous frame, so the sphere is projected with that frame's matrix as well
+bool sphereOccluded(const depthPyramid &pyramid, const glm::mat4 &viewProjection, const glm::vec4 &sphere);
+
+//The inputs shared by the CPU reference and cull.comp
+struct cullParameters {
+    frustum         viewFrustum;
+    glm::mat4       previousViewProjection;
+    bool            occlusionEnabled;
+};
+
+//CPU reference for cull.comp: copies the command of every visible instance to out_commands (which must hold commands.size() entries) and returns how many were written
+//The GPU writes the same set of commands, though not necessarily in the same order
+unsigned int cullInstances(const cullParameters &parameters,
+                           const depthPyramid *pyramid,
+                           const std::vector<glm::vec4> &bounds,
+                           const std::vector<drawCommand> &commands,
+                           drawCommand *out_commands);
@@ -0,0 +1,31 @@
+#version 430 core
+
+//The location corresponds to the value passed into the corresponding calls to glVertexAttribPointer
+layout(location = 0) in vec3 in_pos;
+layout(location = 1) in vec3 in_col;
+layout(location = 3) in vec2 in_uv;
+
+//Per-instance model matrix (locations 4 through 7): the draw command's baseInstance selects the right one
+layout(location = 4) in mat4 in_model;
+
+//Shared by every program and uploaded once per frame (see uniformbuffers.h)
+layout(std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+} camera;
+
+//Declare VS_OUT as an output interface block
+out VS_OUT {
+    vec3 color;
+    vec2 uv;
+} vs_out;
+
+void main() {
+    vs_out.color = in_col;
+    vs_out.uv = in_uv;
+    
+    //Output the position
+    gl_Position = camera.viewProjection * in_model * vec4(in_pos, 1.0);
+}
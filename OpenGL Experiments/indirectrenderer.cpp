@@ -0,0 +1,279 @@
+#include "indirectrenderer.h"
+#include "shaderloader.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+using namespace std;
+
+indirectRenderer::indirectRenderer() {
+    width = height = 0;
+    instanceCount = 0;
+    hasPreviousFrame = false;
+    occlusionEnabled = true;
+    modelBuffer = indexBuffer = boundsBuffer = commandBuffer = visibleCommandBuffer = visibleCountBuffer = 0;
+    framebuffer = colorBuffer = depthTexture = pyramidTexture = 0;
+    pyramidLevels = 0;
+
+    cullProgram = loadComputeShader("cull.comp");
+    hizProgram = loadComputeShader("hiz.comp");
+}
+
+indirectRenderer::~indirectRenderer() {
+    GLuint buffers[] = { modelBuffer, indexBuffer, boundsBuffer, commandBuffer, visibleCommandBuffer, visibleCountBuffer };
+    glDeleteBuffers(6, buffers);
+    glDeleteTextures(1, &depthTexture);
+    glDeleteTextures(1, &pyramidTexture);
+    glDeleteRenderbuffers(1, &colorBuffer);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteProgram(cullProgram);
+    glDeleteProgram(hizProgram);
+}
+
+bool indirectRenderer::isSupported() {
+    return GLEW_VERSION_4_3 || (GLEW_ARB_compute_shader && GLEW_ARB_multi_draw_indirect && GLEW_ARB_shader_storage_buffer_object);
+}
+
+void indirectRenderer::resize(int _width, int _height) {
+    width = _width;
+    height = _height;
+
+    //The pyramid is immutable storage, so everything sized by the window is made again from scratch (deleting 0 is a no-op)
+    glDeleteTextures(1, &depthTexture);
+    glDeleteTextures(1, &pyramidTexture);
+    glDeleteRenderbuffers(1, &colorBuffer);
+    glDeleteFramebuffers(1, &framebuffer);
+
+    //Offscreen framebuffer: the depth has to be a texture so that hiz.comp can read it
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+    glGenTextures(1, &depthTexture);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        cerr << "Offscreen framebuffer is incomplete." << endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    //Depth pyramid: same sizes as depthPyramid on the CPU
+    int baseWidth = depthPyramid::getBaseSize(width);
+    int baseHeight = depthPyramid::getBaseSize(height);
+    pyramidLevels = 1;
+    while ((baseWidth >> pyramidLevels) > 0 || (baseHeight >> pyramidLevels) > 0) {
+        pyramidLevels++;
+    }
+    glGenTextures(1, &pyramidTexture);
+    glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+    glTexStorage2D(GL_TEXTURE_2D, pyramidLevels, GL_R32F, baseWidth, baseHeight);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    //The new pyramid holds nothing yet, so the next cull can't use it
+    hasPreviousFrame = false;
+}
+
+void indirectRenderer::setInstances(const vector<glm::mat4> &models,
+                                    const vector<glm::vec4> &bounds,
+                                    const vector<GLuint> &indices) {
+    instanceCount = GLuint(models.size());
+
+    //One command per instance: baseInstance picks the model matrix out of the instanced attribute below
+    vector<drawCommand> commands(instanceCount);
+    for (GLuint i = 0; i < instanceCount; i++) {
+        commands[i].count = GLuint(indices.size());
+        commands[i].instanceCount = 1;
+        commands[i].firstIndex = 0;
+        commands[i].baseVertex = 0;
+        commands[i].baseInstance = i;
+    }
+    instanceBounds = bounds;
+    instanceCommands = commands;
+
+    //Model matrices: a mat4 attribute takes up four consecutive locations
+    glGenBuffers(1, &modelBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, modelBuffer);
+    glBufferData(GL_ARRAY_BUFFER, models.size() * sizeof(glm::mat4), &models[0], GL_STATIC_DRAW);
+    for (int i = 0; i < 4; i++) {
+        glVertexAttribPointer(4 + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(sizeof(glm::vec4) * i));
+        glEnableVertexAttribArray(4 + i);
+        glVertexAttribDivisor(4 + i, 1);
+    }
+
+    glGenBuffers(1, &indexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices[0], GL_STATIC_DRAW);
+
+    //Inputs of cull.comp never change after this
+    glGenBuffers(1, &boundsBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, boundsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, bounds.size() * sizeof(glm::vec4), &bounds[0], GL_STATIC_DRAW);
+
+    glGenBuffers(1, &commandBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, commands.size() * sizeof(drawCommand), &commands[0], GL_STATIC_DRAW);
+
+    //Outputs of cull.comp, rewritten every frame
+    glGenBuffers(1, &visibleCommandBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleCommandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, commands.size() * sizeof(drawCommand), NULL, GL_DYNAMIC_COPY);
+
+    glGenBuffers(1, &visibleCountBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleCountBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void indirectRenderer::beginFrame(int framebufferWidth, int framebufferHeight) {
+    //A minimised window has a 0x0 framebuffer, which no texture can match
+    framebufferWidth = max(framebufferWidth, 1);
+    framebufferHeight = max(framebufferHeight, 1);
+    if (framebufferWidth != width || framebufferHeight != height) {
+        resize(framebufferWidth, framebufferHeight);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, width, height);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void indirectRenderer::cull(const glm::mat4 &viewProjection) {
+    frustum viewFrustum = extractFrustum(viewProjection);
+
+    glUseProgram(cullProgram);
+    glUniform1ui(glGetUniformLocation(cullProgram, "instanceCount"), instanceCount);
+    glUniform4fv(glGetUniformLocation(cullProgram, "frustumPlanes"), 6, &viewFrustum.planes[0][0]);
+    glUniform1i(glGetUniformLocation(cullProgram, "occlusionEnabled"), occlusionEnabled && hasPreviousFrame);
+    glUniformMatrix4fv(glGetUniformLocation(cullProgram, "previousViewProjection"), 1, GL_FALSE, &previousViewProjection[0][0]);
+    glUniform1i(glGetUniformLocation(cullProgram, "pyramidLevels"), pyramidLevels);
+    glUniform1i(glGetUniformLocation(cullProgram, "depthPyramid"), 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+
+    //Zero the counter, and the command list too: without ARB_indirect_parameters the whole list is drawn and the unused tail must be empty commands
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleCountBuffer);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleCommandBuffer);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, boundsBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, visibleCommandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, visibleCountBuffer);
+    glDispatchCompute((instanceCount + 63) / 64, 1, 1);
+
+    //The draw below reads what the dispatch wrote as indirect commands
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+
+    //The pyramid built at the end of this frame will be tested against this frame's matrix
+    pendingViewProjection = viewProjection;
+}
+
+void indirectRenderer::draw() {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, visibleCommandBuffer);
+    if (GLEW_ARB_indirect_parameters) {
+        //The GPU knows how many commands survived, so let it stop there
+        glBindBuffer(GL_PARAMETER_BUFFER_ARB, visibleCountBuffer);
+        glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, 0, 0, instanceCount, 0);
+    }
+    else {
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0, instanceCount, 0);
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void indirectRenderer::endFrame() {
+    //Copy the finished image to the window
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    //Next frame's occlusion test uses this frame's depth
+    buildDepthPyramid();
+    previousViewProjection = pendingViewProjection;
+    hasPreviousFrame = true;
+}
+
+void indirectRenderer::buildDepthPyramid() {
+    glUseProgram(hizProgram);
+    glUniform1i(glGetUniformLocation(hizProgram, "sourceDepth"), 0);
+    glUniform1i(glGetUniformLocation(hizProgram, "sourcePyramid"), 1);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, depthTexture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, pyramidTexture);
+
+    int levelWidth = depthPyramid::getBaseSize(width);
+    int levelHeight = depthPyramid::getBaseSize(height);
+    for (int level = 0; level < pyramidLevels; level++) {
+        glUniform1i(glGetUniformLocation(hizProgram, "fromDepth"), level == 0);
+        glUniform1i(glGetUniformLocation(hizProgram, "sourceLevel"), level - 1);
+        glBindImageTexture(0, pyramidTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute((levelWidth + 7) / 8, (levelHeight + 7) / 8, 1);
+
+        //The next level reads this one
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        levelWidth = levelWidth > 1 ? levelWidth / 2 : 1;
+        levelHeight = levelHeight > 1 ? levelHeight / 2 : 1;
+    }
+    glActiveTexture(GL_TEXTURE0);
+}
+
+bool indirectRenderer::checkCulling(const glm::mat4 &viewProjection, unsigned int &out_visibleCount) {
+    //The CPU reference gets exactly what cull.comp is about to see, down to the pyramid, which is rebuilt from the depth hiz.comp read
+    cullParameters parameters;
+    parameters.viewFrustum = extractFrustum(viewProjection);
+    parameters.previousViewProjection = previousViewProjection;
+    parameters.occlusionEnabled = occlusionEnabled && hasPreviousFrame;
+    depthPyramid pyramid;
+    if (parameters.occlusionEnabled) {
+        vector<float> depth(size_t(width) * height);
+        glBindTexture(GL_TEXTURE_2D, depthTexture);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, GL_FLOAT, &depth[0]);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        pyramid.build(&depth[0], width, height);
+    }
+    vector<drawCommand> cpuCommands(instanceCommands.size());
+    unsigned int cpuCount = cullInstances(parameters, &pyramid, instanceBounds, instanceCommands, cpuCommands.empty() ? NULL : &cpuCommands[0]);
+
+    cull(viewProjection);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    GLuint gpuCount = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleCountBuffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &gpuCount);
+    vector<drawCommand> gpuCommands(min(gpuCount, instanceCount));
+    if (!gpuCommands.empty()) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleCommandBuffer);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, gpuCommands.size() * sizeof(drawCommand), &gpuCommands[0]);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    //The GPU writes in whatever order its invocations finish, so compare the sets of instances
+    vector<GLuint> cpuInstances, gpuInstances;
+    for (unsigned int i = 0; i < cpuCount; i++) {
+        cpuInstances.push_back(cpuCommands[i].baseInstance);
+    }
+    for (size_t i = 0; i < gpuCommands.size(); i++) {
+        gpuInstances.push_back(gpuCommands[i].baseInstance);
+    }
+    sort(cpuInstances.begin(), cpuInstances.end());
+    sort(gpuInstances.begin(), gpuInstances.end());
+    printf("Culling %u instances (%s): cullInstances() kept %u, cull.comp kept %u\n",
+           instanceCount,
+           parameters.occlusionEnabled ? "frustum and Hi-Z" : "frustum only",
+           cpuCount,
+           gpuCount);
+    out_visibleCount = gpuCount;
+    return gpuCount == cpuCount && gpuInstances == cpuInstances;
+}
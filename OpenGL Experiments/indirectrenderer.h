@@ -0,0 +1,61 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "culling.h"
+
+//GPU-driven render path (requires OpenGL 4.3)
+//All instance bounds and draw commands are uploaded once; every frame cull.comp tests them against the frustum and a Hi-Z pyramid built from the previous frame's depth, and writes a compacted command list that is drawn with a single glMultiDrawElementsIndirect
+//The scene is rendered into an offscreen framebuffer so that its depth can be read back by hiz.comp, then blitted to the window
+//The offscreen targets are single-sampled, so the window must not be multisampled (a blit into a multisampled framebuffer is an error)
+//They follow the window: beginFrame() takes its framebuffer size and rebuilds them whenever that changes
+class indirectRenderer {
+public:
+    indirectRenderer();
+    ~indirectRenderer();
+    static bool     isSupported();
+
+    //Uploads the per-instance data; the currently bound VAO gets the model matrices as attributes 4 through 7 and the indices as its element buffer
+    void            setInstances(const std::vector<glm::mat4> &models,
+                                 const std::vector<glm::vec4> &bounds,
+                                 const std::vector<GLuint> &indices);
+    void            beginFrame(int framebufferWidth, int framebufferHeight);
+    void            cull(const glm::mat4 &viewProjection);
+    void            draw();
+    void            endFrame();
+    void            setOcclusionEnabled(bool enabled) { occlusionEnabled = enabled; }
+
+    //Does cull(), runs cullInstances() on the same inputs (its CPU pyramid rebuilt from the last frame's depth) and returns whether both kept the same instances
+    //Reads the results back, so it stalls: only for CULLING_SELFTEST. beginFrame() clears that depth, so once a frame has ended call this before the next beginFrame()
+    bool            checkCulling(const glm::mat4 &viewProjection, unsigned int &out_visibleCount);
+private:
+    indirectRenderer(const indirectRenderer&);
+    indirectRenderer& operator=(const indirectRenderer&);
+    void            resize(int _width, int _height);
+    void            buildDepthPyramid();
+    int             width;
+    int             height;
+    GLuint          cullProgram;
+    GLuint          hizProgram;
+    GLuint          framebuffer;
+    GLuint          colorBuffer;
+    GLuint          depthTexture;
+    GLuint          pyramidTexture;
+    int             pyramidLevels;
+    GLuint          modelBuffer;
+    GLuint          indexBuffer;
+    GLuint          boundsBuffer;
+    GLuint          commandBuffer;
+    GLuint          visibleCommandBuffer;
+    GLuint          visibleCountBuffer;
+    GLuint          instanceCount;
+
+    //Copies of what cull.comp reads, for checkCulling()
+    std::vector<glm::vec4> instanceBounds;
+    std::vector<drawCommand> instanceCommands;
+    glm::mat4       pendingViewProjection;
+    glm::mat4       previousViewProjection;
+    bool            hasPreviousFrame;
+    bool            occlusionEnabled;
+};
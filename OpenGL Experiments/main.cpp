@@ -6,184 +6,87 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <string>
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <vector>
 #include "controls.h"
+#include "shaderloader.h"
+#include "memory.h"
+#include "bmploader.h"
+#include "texturepacker.h"
+#include "indirectrenderer.h"
+#include "meshcache.h"
+#include "uniformbuffers.h"
+#include "texturestreamer.h"
+#include "streamingselftest.h"
 
 #define CUBE
 //#define DRAW_WIREFRAME
 
-using namespace std;
+//Draw a grid of cubes through the compute-culled glMultiDrawElementsIndirect path (needs OpenGL 4.3, so not on OS X)
+//#define GPU_DRIVEN
+#define GPU_DRIVEN_GRID_SIZE 64
 
-string loadFileToString(const char *filePath) { //Reads a file into memory and returns a string containing that file data
-    string fileData;
-    ifstream stream(filePath, ios::in); //Path and mode
-    if (stream.is_open()) {
-        cout << "Successfully opened file stream." << endl;
-        string line = "";
-        while (getline(stream, line)) { //Takes a stream and an editable string and feeds the line from the stream into the line
-            fileData += "\n" + line;
-        }
-        stream.close();
-    }
-    else {
-        cerr << "Failed to open file stream." << endl;
-    }
-    return fileData;
-}
+//Pack the scene's textures into one array texture (atlas.vert / atlas.frag) so that drawing needs a single texture binding
+//#define TEXTURE_ATLAS
 
-//Should change these to std::string and use string.c_str() when needed (i.e. for fopen)
-GLuint loadShaders(const char *vertShaderPath, const char *fragShaderPath) {
-    GLuint vertShader = glCreateShader(GL_VERTEX_SHADER); //Create IDs for our shaders
-    GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER); //Create IDs for our shaders
-    
-    string vertShaderSource = loadFileToString(vertShaderPath);
-    string fragShaderSource = loadFileToString(fragShaderPath);
-    
-    //glShaderSource requires C-style string parameters, so we do the conversion here
-    const char *rawVertShaderSource = vertShaderSource.c_str();
-    const char *rawFragShaderSource = fragShaderSource.c_str();
-    
-    glShaderSource(vertShader, 1, &rawVertShaderSource, NULL);
-    glShaderSource(fragShader, 1, &rawFragShaderSource, NULL);
-    
-    //VERTEX SHADER
-    glCompileShader(vertShader);
-    GLint success = 0;
-    glGetShaderiv(vertShader, GL_COMPILE_STATUS, &success);
-    
-    //Error logging
-    if (success == GL_FALSE) {
-        cerr << "Error compiling vertex shader." << endl;
-        GLint maxLength = 0;
-        glGetShaderiv(vertShader, GL_INFO_LOG_LENGTH, &maxLength);
-        
-        // The maxLength includes the NULL character
-        std::vector<GLchar> errorLog(maxLength);
-        glGetShaderInfoLog(vertShader, maxLength, &maxLength, &errorLog[0]);
-        
-        for (int i = 0; i < errorLog.size(); i++) {
-            cerr << errorLog[i];
-        }
-        // Provide the infolog in whatever manor you deem best.
-        // Exit with failure.
-        glDeleteShader(vertShader); // Don't leak the shader.
-    }
-    
-    //FRAGMENT SHADER
-    glCompileShader(fragShader);
-    success = 0;
-    glGetShaderiv(fragShader, GL_COMPILE_STATUS, &success);
-    
-    //Error logging
-    if (success == GL_FALSE) {
-        cerr << "Error compiling fragment shader." << endl;
-        GLint maxLength = 0;
-        glGetShaderiv(fragShader, GL_INFO_LOG_LENGTH, &maxLength);
-        
-        // The maxLength includes the NULL character
-        std::vector<GLchar> errorLog(maxLength);
-        glGetShaderInfoLog(fragShader, maxLength, &maxLength, &errorLog[0]);
-        
-        for (int i = 0; i < errorLog.size(); i++) {
-            cerr << errorLog[i];
-        }
-        // Provide the infolog in whatever manor you deem best.
-        // Exit with failure.
-        glDeleteShader(fragShader); // Don't leak the shader.
-    }
-    
-    GLuint program = glCreateProgram(); //Create a program
-    glAttachShader(program, vertShader); //Attach shaders
-    glAttachShader(program, fragShader); //Attach shaders
-    glLinkProgram(program); //We are going to use this program in our application
-    
-    cout << "Successfully loaded shader sources." << endl;
-    
-    return program;
-}
+//Instead of the render loop, draw one frame of the GPU_DRIVEN grid from a fixed camera and check that cull.comp and cullInstances() keep the same instances
+//#define CULLING_SELFTEST
 
-GLuint loadBmp(const char *filePath) {
-    //BMP files always begin with a 54-byte header
-    unsigned char header[54];
-    
-    //Position in the file where the actual image data begins
-    unsigned int dataPos;
-    unsigned int width, height;
-    
-    //Will be width*height*3 (for RGB)
-    unsigned int imageSize;
-    
-    //The actual RGB data
-    unsigned char *data;
-    
-    //Ensure that the file was successfully opened
-    FILE *file = fopen(filePath, "rb");
-    if (!file) {
-        cerr << "Image file could not be opened." << endl;
-        return 0;
-    }
-    
-    //Ensure that the given file is actually BMP-formatted (has a 54-byte header)
-    if (fread(header, 1, 54, file) != 54) {
-        cerr << "Not the correct file format. Image should be a BMP file." << endl;
-        return 0;
-    }
-    
-    //BMP file headers always begin with 'B' and 'M'
-    if (header[0] != 'B' || header[1] != 'M') {
-        cerr << "Not the correct file format. Image should be a BMP file." << endl;
-        return 0;
-    }
-    
-    //Read the size of the image, the location of the data in the file, etc.
-    dataPos = *(int*)&(header[0x0A]);
-    imageSize = *(int*)&(header[0x22]);
-    width = *(int*)&(header[0x12]);
-    height = *(int*)&(header[0x16]);
-    
-    //Since some BMP files are misformatted, make up some information
-    if (imageSize == 0) {
-        //One byte for each R, G, and B component
-        imageSize = width*height*3;
-    }
-    if (dataPos == 0) {
-        dataPos = 54;
+#if defined(CULLING_SELFTEST) && !(defined(GPU_DRIVEN) && defined(CUBE))
+#error "CULLING_SELFTEST checks the culling of the GPU_DRIVEN cube grid"
+#endif
+
+#if defined(TEXTURE_ATLAS) && defined(GPU_DRIVEN)
+#error "The GPU_DRIVEN path does not use the texture atlas yet"
+#endif
+
+//Stream the mips of uvtemplate.tex (written by the bake tool) in and out under a fixed budget instead of loading the whole BMP up front
+//#define TEXTURE_STREAMING
+#define TEXTURE_STREAMING_BUDGET (4 << 20)
+
+#if defined(TEXTURE_STREAMING) && defined(TEXTURE_ATLAS)
+#error "The texture atlas is built from BMPs and can't be streamed"
+#endif
+
+//Instead of opening a window, print the meshlet culling rejection rates for every OBJ given on the command line
+//#define MESHLET_STATS
+
+//Instead of opening a window, drive the texture streamer with a recording backend and check its eviction order, budget denial and tail pinning
+//#define STREAMING_SELFTEST
+
+//One draw of the regular render path: a run of the vertex buffer, instanced once per object from firstObject on (which bindObjects() needs aligned)
+struct sceneDraw {
+    GLint           firstVertex;
+    GLsizei         vertexCount;
+    size_t          firstObject;
+    GLsizei         objectCount;
+};
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+#ifdef MESHLET_STATS
+    //Each OBJ goes through the binary mesh cache (written next to it) so the clusters are only built once
+    for (int i = 1; i < argc; i++) {
+        clusteredMesh mesh;
+        string cachePath = string(argv[i]) + ".mesh";
+        if (loadMesh(argv[i], cachePath.c_str(), mesh)) {
+            printMeshletCullingReport(argv[i], mesh);
+        }
     }
-    
-    //Create a buffer
-    data = new unsigned char[imageSize];
-    
-    //Read the actual data from the file into the buffer
-    fread(data, 1, imageSize, file);
-    
-    //Everything should be in memory now, so close the file
-    fclose(file);
-    
-    //Create one OpenGL texture
-    GLuint texID;
-    glGenTextures(1, &texID);
-    
-    //"Bind" the newly created texture so that all future texture functions will modify this texture
-    glBindTexture(GL_TEXTURE_2D, texID);
-    
-    //Give the image data to OpenGL
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data);
+    return 0;
+#else
+    //Only MESHLET_STATS reads the command line
+    (void)argc;
+    (void)argv;
+#endif
 
-    //When MAGnifying the image (no bigger mipmap available), use LINEAR filtering
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    //When MINifying the image, use a LINEAR blend of two mipmaps, each filtered LINEARLY too
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    //Generate mipmaps, by the way.
-    glGenerateMipmap(GL_TEXTURE_2D);
-    
-    cout << "Successfully loaded a texture from the provided BMP file." << endl;
+#ifdef STREAMING_SELFTEST
+    return runStreamingSelfTest() ? 0 : 1;
+#endif
     
-    return texID;
-}
-
-int main(void) {
     //The window
     GLFWwindow* window;
     
@@ -199,12 +102,21 @@ int main(void) {
      *
      */
     
+#ifndef GPU_DRIVEN
     //4 anti-aliasing
+    //Not for GPU_DRIVEN: it renders into a single-sampled offscreen framebuffer and blits that to the window, and a blit into a multisampled framebuffer is an error
     glfwWindowHint(GLFW_SAMPLES, 4);
+#endif
     
+#ifdef GPU_DRIVEN
+    //Compute shaders and multi-draw-indirect are core in OpenGL 4.3
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+#else
     //Set the OpenGL major and minor versions to 3 (essentially setting up OpenGL 3.3)
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+#endif
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
     
     //We only want the core OpenGL functionality...we don't care about backwards-compatibility right now
@@ -212,6 +124,16 @@ int main(void) {
     
     //Create a window and its OpenGL context
     window = glfwCreateWindow(640, 480, "Hello World", NULL, NULL);
+#ifdef GPU_DRIVEN
+    if (!window) {
+        //No 4.3 here (OS X stops at 4.1): ask for the baseline context instead and let the regular render path take over, anti-aliased as usual
+        cerr << "OpenGL 4.3 is not available: falling back to the regular render path." << endl;
+        glfwWindowHint(GLFW_SAMPLES, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+        window = glfwCreateWindow(640, 480, "Hello World", NULL, NULL);
+    }
+#endif
     if (!window)
     {
         cerr << "GLFW window failed to create" << endl;
@@ -240,7 +162,11 @@ int main(void) {
     //1. In Xcode, navigate to Product -> Scheme -> Edit Scheme
     //2. Select the Run tab from the table view on the left side of the window
     //3. Under the Options tab, change the "Working Directory" to this project's directory
+#ifdef TEXTURE_ATLAS
+    GLuint program = loadShaders("atlas.vert", "atlas.frag");
+#else
     GLuint program = loadShaders("basic.vert", "basic.frag");
+#endif
     
     //Generate a vertex array
     GLuint vaoID; //An ID in OpenGL
@@ -354,18 +280,82 @@ int main(void) {
     glBindBuffer(GL_ARRAY_BUFFER, vboID); //Tells OpenGL we are going to use / modify this buffer now
     glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW); //Fill the buffer with data
     
+#ifdef TEXTURE_ATLAS
+    //Pack every texture the scene uses into the layers of one array texture, then point the UVs at where each one ended up
+    //A 1024x1024 layer with mips 0 through 2 kept free of bleeding between neighbours
+    vector<glm::vec2> atlasUVs;
+    for (size_t i = 0; i < sizeof(uvs) / sizeof(uvs[0]); i += 2) {
+        atlasUVs.push_back(glm::vec2(uvs[i], uvs[i+1]));
+    }
+    vector<float> atlasLayers(atlasUVs.size(), 0.0f);
+    textureAtlasBuilder atlas(1024, 2);
+    GLuint tex = 0;
+    {
+        //The builder copies the pixels into its layers, so the decoded images only need to live until build()
+        arenaScope scope(scratchArena());
+        image uvTemplate;
+        if (decodeBmp("uvtemplate.bmp", scratchArena(), uvTemplate)) {
+            size_t cubeTexture = atlas.add(uvTemplate);
+            if (atlas.build()) {
+                tex = atlas.upload();
+                remapUVs(atlasUVs, atlas.getEntry(cubeTexture));
+                atlasLayers = makeLayerAttribute(atlasUVs.size(), atlas.getEntry(cubeTexture));
+            }
+        }
+    }
+    atlas.printStats();
+    GLenum texTarget = GL_TEXTURE_2D_ARRAY;
+    
+    //Generate a buffer for storing UV coordinates
+    GLuint uvID;
+    glGenBuffers(1, &uvID);
+    glBindBuffer(GL_ARRAY_BUFFER, uvID);
+    glBufferData(GL_ARRAY_BUFFER, atlasUVs.size() * sizeof(glm::vec2), &atlasUVs[0], GL_STATIC_DRAW);
+    
+    //Generate a buffer for storing the array layer of every vertex
+    GLuint layerID;
+    glGenBuffers(1, &layerID);
+    glBindBuffer(GL_ARRAY_BUFFER, layerID);
+    glBufferData(GL_ARRAY_BUFFER, atlasLayers.size() * sizeof(float), &atlasLayers[0], GL_STATIC_DRAW);
+#else
     //Generate a buffer for storing UV coordinates
     GLuint uvID;
     glGenBuffers(1, &uvID);
     glBindBuffer(GL_ARRAY_BUFFER, uvID);
     glBufferData(GL_ARRAY_BUFFER, sizeof(uvs), uvs, GL_STATIC_DRAW);
     
+#ifdef TEXTURE_STREAMING
+    //Only the low mips are loaded here; the rest follow as the camera comes closer
+    glTextureBackend streamingBackend;
+    textureStreamer *streamer = new textureStreamer(streamingBackend, TEXTURE_STREAMING_BUDGET, 2);
+    int streamedTex = streamer->addTexture("uvtemplate.tex");
+    GLuint tex = streamedTex >= 0 ? streamer->getTexture(streamedTex) : loadBmp("uvtemplate.bmp");
+    
+    //How much of the texture lands on each unit of the cube's surface
+    vector<glm::vec3> streamPositions;
+    vector<glm::vec2> streamUVs;
+    for (size_t i = 0; i < sizeof(verts) / sizeof(verts[0]) / 3; i++) {
+        streamPositions.push_back(glm::vec3(verts[i*3], verts[i*3+1], verts[i*3+2]));
+        streamUVs.push_back(glm::vec2(uvs[i*2], uvs[i*2+1]));
+    }
+    float cubeUVDensity = computeUVDensity(streamPositions, streamUVs);
+#else
     //Load the texture
     GLuint tex = loadBmp("uvtemplate.bmp");
+#endif
+    GLenum texTarget = GL_TEXTURE_2D;
+#endif
     
     //Get a handle for the "samp" uniform
     GLuint texID = glGetUniformLocation(program, "samp");
     
+    //The sampler always reads Texture Unit 0, so it only has to be set once (uniforms need to be set AFTER the call to glUseProgram)
+    glUseProgram(program);
+    glUniform1i(texID, 0);
+    
+    //Hook the program's uniform blocks up to the shared camera and object buffers
+    bindUniformBlocks(program);
+    
     
     
     
@@ -394,6 +384,27 @@ int main(void) {
      */
 
     controls controls(window);
+    
+    //The camera block is refilled once per frame; the objects only when they move (and the cube never does)
+    //Both are deleted by hand below, while the context still exists
+    cameraBuffer *camera = new cameraBuffer();
+    objectBuffer *objects = new objectBuffer(1);
+    objects->setModel(0, glm::mat4(1.0f));
+    objects->upload();
+    
+    //The draw records are all the same size, so they come from a pool and can be added and removed without going to the system allocator
+    poolAllocator *drawPool = new poolAllocator(sizeof(sceneDraw), 64, MEMORY_SCENE);
+    vector<sceneDraw*> sceneDraws;
+    sceneDraw *cubeDraw = static_cast<sceneDraw*>(drawPool->allocate());
+    cubeDraw->firstVertex = 0;
+#ifdef CUBE
+    cubeDraw->vertexCount = 12*3;
+#else
+    cubeDraw->vertexCount = 3;
+#endif
+    cubeDraw->firstObject = 0;
+    cubeDraw->objectCount = 1;
+    sceneDraws.push_back(cubeDraw);
 
     //OLDER DEFAULT VIEW
 //    //Projection matrix: 45° Field of View, 4:3 ratio, display range : 0.1 unit <-> 100 units
@@ -411,6 +422,100 @@ int main(void) {
 //    //The ModelViewProjection matrix is the combination of the previous 3 matrices
 //    glm::mat4 ModelViewProjection = Projection * View * Model;
     
+#if defined(GPU_DRIVEN) && defined(CUBE)
+    //A GPU_DRIVEN_GRID_SIZE x GPU_DRIVEN_GRID_SIZE grid of cubes on the ground plane, uploaded once
+    indirectRenderer *gpuRenderer = NULL;
+    GLuint indirectProgram = 0;
+    if (indirectRenderer::isSupported()) {
+        gpuRenderer = new indirectRenderer();
+        indirectProgram = loadShaders("indirect.vert", "basic.frag");
+        bindUniformBlocks(indirectProgram);
+        glUseProgram(indirectProgram);
+        glUniform1i(glGetUniformLocation(indirectProgram, "samp"), 0);
+        
+        //The cube isn't indexed, so the indices just walk the vertices in order
+        vector<glm::vec3> cubePoints;
+        vector<GLuint> cubeIndices;
+        for (int i = 0; i < 12*3; i++) {
+            cubePoints.push_back(glm::vec3(verts[i*3], verts[i*3+1], verts[i*3+2]));
+            cubeIndices.push_back(i);
+        }
+        glm::vec4 cubeSphere = computeBoundingSphere(cubePoints);
+        
+        vector<glm::mat4> models;
+        vector<glm::vec4> bounds;
+        models.reserve(GPU_DRIVEN_GRID_SIZE * GPU_DRIVEN_GRID_SIZE);
+        bounds.reserve(GPU_DRIVEN_GRID_SIZE * GPU_DRIVEN_GRID_SIZE);
+        for (int z = 0; z < GPU_DRIVEN_GRID_SIZE; z++) {
+            for (int x = 0; x < GPU_DRIVEN_GRID_SIZE; x++) {
+                glm::vec3 offset(4.0f * (x - GPU_DRIVEN_GRID_SIZE / 2), -2.0f, -4.0f * z);
+                models.push_back(glm::translate(glm::mat4(1.0f), offset));
+                bounds.push_back(transformBoundingSphere(cubeSphere, models.back()));
+            }
+        }
+        glBindVertexArray(vaoID);
+        gpuRenderer->setInstances(models, bounds, cubeIndices);
+    }
+    else {
+        cerr << "The context lacks compute shaders or multi-draw-indirect: falling back to the regular render path." << endl;
+    }
+#endif
+
+#ifdef CULLING_SELFTEST
+    {
+        //Standing in the middle column right in front of its first cube, which hides most of the cubes behind it
+        bool passed = false;
+        if (gpuRenderer != NULL) {
+            int framebufferWidth, framebufferHeight;
+            glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+            glm::vec3 eye(0.0f, -2.0f, 4.0f);
+            glm::mat4 testProjection = glm::perspective(45.0f, float(max(framebufferWidth, 1)) / float(max(framebufferHeight, 1)), 0.1f, 100.0f);
+            glm::mat4 testView = glm::lookAt(eye, glm::vec3(0.0f, -2.0f, -10.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            glm::mat4 testViewProjection = testProjection * testView;
+            camera->update(testView, testProjection, eye);
+            
+            //The first frame has no pyramid yet, so only the frustum applies
+            unsigned int frustumVisible = 0;
+            gpuRenderer->beginFrame(framebufferWidth, framebufferHeight);
+            bool frustumMatches = gpuRenderer->checkCulling(testViewProjection, frustumVisible);
+            
+            //Draw that frame so the next cull has its depth as the Hi-Z pyramid
+            glBindBuffer(GL_ARRAY_BUFFER, vboID);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+            glEnableVertexAttribArray(0);
+            glBindBuffer(GL_ARRAY_BUFFER, uvID);
+            glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+            glEnableVertexAttribArray(3);
+            glUseProgram(indirectProgram);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, tex);
+            gpuRenderer->draw();
+            gpuRenderer->endFrame();
+            
+            unsigned int occlusionVisible = 0;
+            bool occlusionMatches = gpuRenderer->checkCulling(testViewProjection, occlusionVisible);
+            printf("%s: cull.comp matches cullInstances() against the frustum\n", frustumMatches ? "pass" : "FAIL");
+            printf("%s: cull.comp matches cullInstances() against the frustum and Hi-Z\n", occlusionMatches ? "pass" : "FAIL");
+            printf("%s: the Hi-Z pyramid rejects instances the frustum keeps\n", occlusionVisible < frustumVisible ? "pass" : "FAIL");
+            passed = frustumMatches && occlusionMatches && occlusionVisible < frustumVisible;
+        }
+        else {
+            cerr << "The culling self test needs the GPU_DRIVEN path, which this context can't run." << endl;
+        }
+        printf("Culling self test: %s\n", passed ? "PASS" : "FAIL");
+        delete gpuRenderer;
+        glDeleteProgram(indirectProgram);
+        delete camera;
+        delete objects;
+        for (size_t i = 0; i < sceneDraws.size(); i++) {
+            drawPool->release(sceneDraws[i]);
+        }
+        delete drawPool;
+        glfwTerminate();
+        return passed ? 0 : 1;
+    }
+#endif
+    
 #ifdef DRAW_WIREFRAME
     //Draw the wireframe
     glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -419,11 +524,33 @@ int main(void) {
     //Loop until the user closes the window
     while (!glfwWindowShouldClose(window))
     {
+        //Everything allocated from the frame arena during the previous frame is now dead
+        frameArena().reset();
+        
         controls.computeMatricesFromInputs();
         glm::mat4 Projection = controls.getProjectionMatrix();
         glm::mat4 View = controls.getViewMatrix();
-        glm::mat4 Model = glm::mat4(1.0f);
-        glm::mat4 ModelViewProjection = Projection * View * Model;
+        
+        //One upload serves every program drawn this frame
+        camera->update(View, Projection, controls.getPosition());
+        
+#ifdef TEXTURE_STREAMING
+        if (streamedTex >= 0) {
+            //The cube sits at the origin, so the closest its surface can be is the camera's distance minus its bounding radius
+            int framebufferWidth, framebufferHeight;
+            glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+            float distance = max(glm::length(controls.getPosition()) - sqrt(3.0f), 0.1f);
+            streamer->requestLevel(streamedTex, estimateMipLevel(streamer->getWidth(streamedTex),
+                                                                 streamer->getHeight(streamedTex),
+                                                                 cubeUVDensity,
+                                                                 distance,
+                                                                 Projection[1][1],
+                                                                 framebufferHeight));
+        }
+        
+        //Uploads finished levels and queues the next ones; the texture's binding may change, but the draws below bind it again anyway
+        streamer->update();
+#endif
         /*
          *
          * All rendering happens below
@@ -450,24 +577,54 @@ int main(void) {
         glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, 0, NULL);
         glEnableVertexAttribArray(3);
         
-        //Use the shaders we've loaded above
-        glUseProgram(program);
-        
-        //Uniforms need to be set AFTER the call to glUseProgram
-        GLuint MatrixID = glGetUniformLocation(program, "ModelViewProjection");
-        glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &ModelViewProjection[0][0]);
-    
-        //Bind the texture in Texture Unit 0
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, tex);
-        glUniform1i(texID, 0);
+#ifdef TEXTURE_ATLAS
+        //Attribute 2 selects the array layer
+        glBindBuffer(GL_ARRAY_BUFFER, layerID);
+        glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, 0, NULL);
+        glEnableVertexAttribArray(2);
+#endif
         
-        //Draw the vertices
-#ifdef CUBE
-        glDrawArrays(GL_TRIANGLES, 0, 12*3);
-#else
-        glDrawArrays(GL_TRIANGLES, 0, 3);
+#if defined(GPU_DRIVEN) && defined(CUBE)
+        if (gpuRenderer != NULL) {
+            //Cull every instance on the GPU, then draw whatever survived with a single call
+            glm::mat4 ViewProjection = Projection * View;
+            int framebufferWidth, framebufferHeight;
+            glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+            gpuRenderer->beginFrame(framebufferWidth, framebufferHeight);
+            gpuRenderer->cull(ViewProjection);
+            
+            glUseProgram(indirectProgram);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, tex);
+            
+            gpuRenderer->draw();
+            gpuRenderer->endFrame();
+        }
+        else
 #endif
+        {
+            //Use the shaders we've loaded above
+            glUseProgram(program);
+            
+            //Bind the texture in Texture Unit 0
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(texTarget, tex);
+            
+            //This frame's draw list only lives until the next frame, so it goes in the frame arena
+            sceneDraw **drawList = frameArena().allocateArray<sceneDraw*>(sceneDraws.size());
+            size_t drawCount = 0;
+            for (size_t i = 0; i < sceneDraws.size(); i++) {
+                if (sceneDraws[i]->objectCount > 0) {
+                    drawList[drawCount++] = sceneDraws[i];
+                }
+            }
+            
+            //Draw the vertices: the matrices come from the uniform buffers, and the instance index picks the object
+            for (size_t i = 0; i < drawCount; i++) {
+                objects->bindObjects(drawList[i]->firstObject);
+                glDrawArraysInstanced(GL_TRIANGLES, drawList[i]->firstVertex, drawList[i]->vertexCount, drawList[i]->objectCount);
+            }
+        }
         
         //Disable the attributes at position 0 and 1 (the vertex color and position)
         glDisableVertexAttribArray(0);
@@ -483,12 +640,32 @@ int main(void) {
     //Cleanup VBO and shader
     glDeleteBuffers(1, &vboID);
     glDeleteBuffers(1, &uvID);
+#ifdef TEXTURE_ATLAS
+    glDeleteBuffers(1, &layerID);
+#endif
     glDeleteProgram(program);
     glDeleteTextures(1, &texID);
     glDeleteVertexArrays(1, &vaoID);
+    delete camera;
+    delete objects;
+    for (size_t i = 0; i < sceneDraws.size(); i++) {
+        drawPool->release(sceneDraws[i]);
+    }
+    delete drawPool;
+#ifdef TEXTURE_STREAMING
+    streamer->printStats();
+    delete streamer;
+#endif
+#if defined(GPU_DRIVEN) && defined(CUBE)
+    delete gpuRenderer;
+    glDeleteProgram(indirectProgram);
+#endif
     
     //Close the OpenGL window and terminate GLFW
     glfwTerminate();
     
+    //Report how much memory each subsystem used over the run
+    memoryTracker::printStats();
+    
     return 0;
 }
\ No newline at end of file
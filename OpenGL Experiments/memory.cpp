@@ -0,0 +1,323 @@
+#include "memory.h"
+#include <atomic>
+#include <cstdlib>
+#include <cstdio>
+
+//The counters for every subsystem live in static storage and are only ever touched atomically
+static std::atomic<size_t> allocationCounts[MEMORY_SUBSYSTEM_COUNT];
+static std::atomic<size_t> freeCounts[MEMORY_SUBSYSTEM_COUNT];
+static std::atomic<size_t> bytesInUse[MEMORY_SUBSYSTEM_COUNT];
+static std::atomic<size_t> peakBytes[MEMORY_SUBSYSTEM_COUNT];
+static std::atomic<size_t> totalBytes[MEMORY_SUBSYSTEM_COUNT];
+
+//Rounds value up to the next multiple of alignment (which must be a power of two)
+static size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+/*
+ *
+ * memoryTracker
+ *
+ */
+
+void* memoryTracker::allocate(size_t size, memorySubsystem subsystem) {
+    void *ptr = malloc(size);
+    if (ptr == NULL) {
+        fprintf(stderr, "Out of memory while allocating %zu bytes for %s.\n", size, getSubsystemName(subsystem));
+        return NULL;
+    }
+
+    allocationCounts[subsystem]++;
+    totalBytes[subsystem] += size;
+    size_t inUse = bytesInUse[subsystem] += size;
+
+    //Bump the high-water mark if another thread hasn't already pushed it past us
+    size_t peak = peakBytes[subsystem].load();
+    while (inUse > peak && !peakBytes[subsystem].compare_exchange_weak(peak, inUse)) {
+    }
+    return ptr;
+}
+
+void memoryTracker::release(void *ptr, size_t size, memorySubsystem subsystem) {
+    if (ptr == NULL) {
+        return;
+    }
+    freeCounts[subsystem]++;
+    bytesInUse[subsystem] -= size;
+    free(ptr);
+}
+
+memoryStats memoryTracker::getStats(memorySubsystem subsystem) {
+    memoryStats stats;
+    stats.allocations = allocationCounts[subsystem].load();
+    stats.frees = freeCounts[subsystem].load();
+    stats.bytesInUse = bytesInUse[subsystem].load();
+    stats.peakBytes = peakBytes[subsystem].load();
+    stats.totalBytes = totalBytes[subsystem].load();
+    return stats;
+}
+
+const char* memoryTracker::getSubsystemName(memorySubsystem subsystem) {
+    switch (subsystem) {
+        case MEMORY_FRAME:   return "frame";
+        case MEMORY_LOADER:  return "loader";
+        case MEMORY_TEXTURE: return "texture";
+        case MEMORY_SCENE:   return "scene";
+        default:             return "unknown";
+    }
+}
+
+void memoryTracker::printStats() {
+    printf("%-10s %12s %12s %14s %14s %14s\n", "subsystem", "allocs", "frees", "in use", "peak", "total");
+    for (int i = 0; i < MEMORY_SUBSYSTEM_COUNT; i++) {
+        memoryStats stats = getStats(memorySubsystem(i));
+        printf("%-10s %12zu %12zu %14zu %14zu %14zu\n",
+               getSubsystemName(memorySubsystem(i)),
+               stats.allocations,
+               stats.frees,
+               stats.bytesInUse,
+               stats.peakBytes,
+               stats.totalBytes);
+    }
+}
+
+/*
+ *
+ * arena
+ *
+ */
+
+arena::arena(size_t _blockSize, memorySubsystem _subsystem) {
+    blockSize = _blockSize;
+    subsystem = _subsystem;
+    current = 0;
+    peakBytesUsed = 0;
+}
+
+arena::~arena() {
+    for (size_t i = 0; i < blocks.size(); i++) {
+        memoryTracker::release(blocks[i].data, blocks[i].size, subsystem);
+    }
+}
+
+void* arena::allocate(size_t size, size_t alignment) {
+    //Try the current block first, then fall through to the next one (creating it if needed)
+    while (current < blocks.size()) {
+        block &b = blocks[current];
+        size_t base = reinterpret_cast<size_t>(b.data);
+        size_t offset = alignUp(base + b.used, alignment) - base;
+        if (offset + size <= b.size) {
+            b.used = offset + size;
+            size_t used = getBytesUsed();
+            if (used > peakBytesUsed) {
+                peakBytesUsed = used;
+            }
+            return b.data + offset;
+        }
+
+        //Blocks past the current one are empty, so one that is too small for this request can simply be swapped for a bigger one
+        if (current + 1 < blocks.size() && blocks[current + 1].size < size + alignment) {
+            memoryTracker::release(blocks[current + 1].data, blocks[current + 1].size, subsystem);
+            blocks.erase(blocks.begin() + current + 1);
+        }
+        if (current + 1 == blocks.size()) {
+            break;
+        }
+        current++;
+        blocks[current].used = 0;
+    }
+
+    //Oversized requests get a block of their own
+    block b;
+    b.size = size + alignment > blockSize ? size + alignment : blockSize;
+    b.used = 0;
+    b.data = static_cast<unsigned char*>(memoryTracker::allocate(b.size, subsystem));
+    if (b.data == NULL) {
+        return NULL;
+    }
+    if (!blocks.empty()) {
+        current++;
+    }
+    blocks.insert(blocks.begin() + current, b);
+    return allocate(size, alignment);
+}
+
+arenaMarker arena::getMarker() const {
+    arenaMarker marker;
+    marker.block = current;
+    marker.offset = blocks.empty() ? 0 : blocks[current].used;
+    return marker;
+}
+
+void arena::rewind(arenaMarker marker) {
+    if (blocks.empty()) {
+        return;
+    }
+    current = marker.block;
+    blocks[current].used = marker.offset;
+    for (size_t i = current + 1; i < blocks.size(); i++) {
+        blocks[i].used = 0;
+    }
+
+    //Back at the start nothing is live, so the oversized blocks can go; the regular ones stay for reuse
+    if (marker.block == 0 && marker.offset == 0) {
+        for (size_t i = blocks.size(); i > 0; i--) {
+            if (blocks[i - 1].size > blockSize) {
+                memoryTracker::release(blocks[i - 1].data, blocks[i - 1].size, subsystem);
+                blocks.erase(blocks.begin() + (i - 1));
+            }
+        }
+    }
+}
+
+void arena::reset() {
+    arenaMarker start = {0, 0};
+    rewind(start);
+}
+
+size_t arena::getBytesUsed() const {
+    size_t used = 0;
+    for (size_t i = 0; i <= current && i < blocks.size(); i++) {
+        used += blocks[i].used;
+    }
+    return used;
+}
+
+size_t arena::getPeakBytesUsed() const {
+    return peakBytesUsed;
+}
+
+/*
+ *
+ * poolAllocator
+ *
+ */
+
+poolAllocator::poolAllocator(size_t _elementSize, size_t _elementsPerBlock, memorySubsystem _subsystem) {
+    //Every free element stores the pointer to the next one, so it has to be able to hold (and be aligned for) a pointer
+    elementSize = alignUp(_elementSize < sizeof(void*) ? sizeof(void*) : _elementSize, sizeof(void*));
+    elementsPerBlock = _elementsPerBlock;
+    subsystem = _subsystem;
+    freeList = NULL;
+    liveCount = 0;
+}
+
+poolAllocator::~poolAllocator() {
+    for (size_t i = 0; i < blocks.size(); i++) {
+        memoryTracker::release(blocks[i], elementSize * elementsPerBlock, subsystem);
+    }
+}
+
+void poolAllocator::grow() {
+    unsigned char *data = static_cast<unsigned char*>(memoryTracker::allocate(elementSize * elementsPerBlock, subsystem));
+    if (data == NULL) {
+        return;
+    }
+    blocks.push_back(data);
+
+    //Thread the new elements onto the free list back to front so they are handed out in address order
+    for (size_t i = elementsPerBlock; i > 0; i--) {
+        void *element = data + (i - 1) * elementSize;
+        *static_cast<void**>(element) = freeList;
+        freeList = element;
+    }
+}
+
+void* poolAllocator::allocate() {
+    if (freeList == NULL) {
+        grow();
+        if (freeList == NULL) {
+            return NULL;
+        }
+    }
+    void *element = freeList;
+    freeList = *static_cast<void**>(element);
+    liveCount++;
+    return element;
+}
+
+void poolAllocator::release(void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    *static_cast<void**>(ptr) = freeList;
+    freeList = ptr;
+    liveCount--;
+}
+
+/*
+ *
+ * sizeClassAllocator
+ *
+ */
+
+sizeClassAllocator::sizeClassAllocator(memorySubsystem _subsystem) {
+    subsystem = _subsystem;
+
+    //Aim for roughly 64KB per block regardless of the size class
+    for (size_t i = 0; i < classCount; i++) {
+        size_t elementSize = smallestClass << i;
+        pools[i] = new poolAllocator(elementSize, 65536 / elementSize, subsystem);
+    }
+}
+
+sizeClassAllocator::~sizeClassAllocator() {
+    for (size_t i = 0; i < classCount; i++) {
+        delete pools[i];
+    }
+}
+
+int sizeClassAllocator::getClassIndex(size_t size) const {
+    size_t classSize = smallestClass;
+    for (size_t i = 0; i < classCount; i++) {
+        if (size <= classSize) {
+            return int(i);
+        }
+        classSize <<= 1;
+    }
+    return -1;
+}
+
+void* sizeClassAllocator::allocate(size_t size) {
+    int index = getClassIndex(size);
+    if (index < 0) {
+        return memoryTracker::allocate(size, subsystem);
+    }
+    return pools[index]->allocate();
+}
+
+void sizeClassAllocator::release(void *ptr, size_t size) {
+    int index = getClassIndex(size);
+    if (index < 0) {
+        memoryTracker::release(ptr, size, subsystem);
+        return;
+    }
+    pools[index]->release(ptr);
+}
+
+/*
+ *
+ * Shared arenas
+ *
+ */
+
+arena& frameArena() {
+    static arena instance(1 << 20, MEMORY_FRAME);
+    return instance;
+}
+
+//__thread rather than thread_local: the compiler this project is built with only supports the former
+static __thread arena *threadScratchArena = NULL;
+
+arena& scratchArena() {
+    if (threadScratchArena != NULL) {
+        return *threadScratchArena;
+    }
+    static arena instance(16 << 20, MEMORY_LOADER);
+    return instance;
+}
+
+void setThreadScratchArena(arena *scratch) {
+    threadScratchArena = scratch;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+//Every tracked allocation is tagged with the subsystem that asked for it
+enum memorySubsystem {
+    MEMORY_FRAME,
+    MEMORY_LOADER,
+    MEMORY_TEXTURE,
+    MEMORY_SCENE,
+    MEMORY_SUBSYSTEM_COUNT
+};
+
+//A snapshot of the counters kept for one subsystem
+struct memoryStats {
+    size_t allocations;
+    size_t frees;
+    size_t bytesInUse;
+    size_t peakBytes;
+    size_t totalBytes;
+};
+
+//Wraps malloc / free and keeps per-subsystem counts, bytes and high-water marks
+//The counters are atomic, so this is safe to call from worker threads
+class memoryTracker {
+public:
+    static void*        allocate(size_t size, memorySubsystem subsystem);
+    static void         release(void *ptr, size_t size, memorySubsystem subsystem);
+    static memoryStats  getStats(memorySubsystem subsystem);
+    static const char*  getSubsystemName(memorySubsystem subsystem);
+    static void         printStats();
+};
+
+//A position inside an arena that it can later be rewound to
+struct arenaMarker {
+    size_t block;
+    size_t offset;
+};
+
+//A linear (bump pointer) allocator
+//Memory comes from a small list of large blocks that are kept around and reused after a reset, so a warmed-up arena never touches the system allocator
+//Individual allocations can't be freed: either rewind to a marker or reset the whole arena
+//Blocks bigger than the block size (made for oversized requests) are given back once the arena is rewound to its start, so one huge load doesn't pin its memory forever
+//Destructors are never run, so only use this for plain data
+class arena {
+public:
+    arena(size_t _blockSize, memorySubsystem _subsystem);
+    ~arena();
+    void*           allocate(size_t size, size_t alignment = 16);
+    template<typename T>
+    T*              allocateArray(size_t count) { return static_cast<T*>(allocate(sizeof(T) * count, alignof(T))); }
+    arenaMarker     getMarker() const;
+    void            rewind(arenaMarker marker);
+    void            reset();
+    size_t          getBytesUsed() const;
+    size_t          getPeakBytesUsed() const;
+private:
+    struct block {
+        unsigned char*  data;
+        size_t          size;
+        size_t          used;
+    };
+    arena(const arena&);
+    arena&          operator=(const arena&);
+    std::vector<block> blocks;
+    size_t          current;
+    size_t          blockSize;
+    size_t          peakBytesUsed;
+    memorySubsystem subsystem;
+};
+
+//Rewinds an arena to wherever it was when the scope was entered, which makes it easy to use an arena for temporary (scratch) memory
+class arenaScope {
+public:
+    arenaScope(arena &_target) : target(_target), marker(_target.getMarker()) {}
+    ~arenaScope() { target.rewind(marker); }
+private:
+    arenaScope(const arenaScope&);
+    arenaScope&     operator=(const arenaScope&);
+    arena&          target;
+    arenaMarker     marker;
+};
+
+//Hands out fixed-size records from large blocks and recycles them through a free list
+//Not thread-safe: give each thread its own pool
+class poolAllocator {
+public:
+    poolAllocator(size_t _elementSize, size_t _elementsPerBlock, memorySubsystem _subsystem);
+    ~poolAllocator();
+    void*           allocate();
+    void            release(void *ptr);
+    size_t          getElementSize() const { return elementSize; }
+    size_t          getLiveCount() const { return liveCount; }
+private:
+    poolAllocator(const poolAllocator&);
+    poolAllocator&  operator=(const poolAllocator&);
+    void            grow();
+    std::vector<void*> blocks;
+    void*           freeList;
+    size_t          elementSize;
+    size_t          elementsPerBlock;
+    size_t          liveCount;
+    memorySubsystem subsystem;
+};
+
+//A set of pools with power-of-two size classes (16 to 1024 bytes)
+//Anything bigger goes straight to the tracker, so callers must pass the same size to release as they did to allocate
+class sizeClassAllocator {
+public:
+    sizeClassAllocator(memorySubsystem _subsystem);
+    ~sizeClassAllocator();
+    void*           allocate(size_t size);
+    void            release(void *ptr, size_t size);
+private:
+    static const size_t smallestClass = 16;
+    static const size_t classCount = 7;
+    sizeClassAllocator(const sizeClassAllocator&);
+    sizeClassAllocator& operator=(const sizeClassAllocator&);
+    int             getClassIndex(size_t size) const;
+    poolAllocator*  pools[classCount];
+    memorySubsystem subsystem;
+};
+
+//Reset once at the top of every frame: anything allocated from it is only valid until the next frame
+arena&  frameArena();
+
+//Temporary memory for the loaders; always wrap its use in an arenaScope
+//Both of these are for the main thread only, unless a worker thread has installed its own scratch arena
+arena&  scratchArena();
+
+//Makes scratchArena() return the given arena on the calling thread, so the loaders can run on worker threads; pass NULL to go back to the shared one
+void    setThreadScratchArena(arena *scratch);
@@ -0,0 +1,172 @@
+#include "meshcache.h"
+#include "objloader.h"
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+
+struct meshCacheHeader {
+    char            magic[4];
+    unsigned int    version;
+    unsigned int    vertexCount;
+    unsigned int    indexCount;
+    unsigned int    meshletCount;
+    unsigned int    meshletVertexCount;
+    unsigned int    meshletTriangleCount;
+};
+
+template<typename T>
+static bool writeArray(FILE *file, const std::vector<T> &data) {
+    return data.empty() || fwrite(&data[0], sizeof(T), data.size(), file) == data.size();
+}
+
+template<typename T>
+static bool readArray(FILE *file, std::vector<T> &data, size_t count) {
+    data.resize(count);
+    return count == 0 || fread(&data[0], sizeof(T), count, file) == count;
+}
+
+//Every index has to land inside the arrays it points into, or drawing and culling would read past them
+static bool validateMesh(const clusteredMesh &mesh) {
+    size_t vertexCount = mesh.positions.size();
+    if (mesh.indices.size() % 3 != 0) {
+        return false;
+    }
+    for (size_t i = 0; i < mesh.indices.size(); i++) {
+        if (mesh.indices[i] >= vertexCount) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < mesh.meshletVertices.size(); i++) {
+        if (mesh.meshletVertices[i] >= vertexCount) {
+            return false;
+        }
+    }
+    size_t triangleCount = mesh.meshletTriangles.size() / 3;
+    for (size_t i = 0; i < mesh.meshlets.size(); i++) {
+        const meshlet &m = mesh.meshlets[i];
+        if (m.vertexCount > MESHLET_MAX_VERTICES ||
+            m.triangleCount > MESHLET_MAX_TRIANGLES ||
+            size_t(m.vertexOffset) + m.vertexCount > mesh.meshletVertices.size() ||
+            size_t(m.triangleOffset) + m.triangleCount > triangleCount) {
+            return false;
+        }
+        for (size_t j = size_t(m.triangleOffset) * 3; j < size_t(m.triangleOffset + m.triangleCount) * 3; j++) {
+            if (mesh.meshletTriangles[j] >= m.vertexCount) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool saveMeshCache(const char *cachePath, const clusteredMesh &mesh) {
+    FILE *file = fopen(cachePath, "wb");
+    if (file == NULL) {
+        cerr << "Failed to create mesh cache " << cachePath << "." << endl;
+        return false;
+    }
+
+    meshCacheHeader header;
+    memcpy(header.magic, "MESH", 4);
+    header.version = MESH_CACHE_VERSION;
+    header.vertexCount = (unsigned int)mesh.positions.size();
+    header.indexCount = (unsigned int)mesh.indices.size();
+    header.meshletCount = (unsigned int)mesh.meshlets.size();
+    header.meshletVertexCount = (unsigned int)mesh.meshletVertices.size();
+    header.meshletTriangleCount = (unsigned int)(mesh.meshletTriangles.size() / 3);
+
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   writeArray(file, mesh.positions) &&
+                   writeArray(file, mesh.uvs) &&
+                   writeArray(file, mesh.normals) &&
+                   writeArray(file, mesh.indices) &&
+                   writeArray(file, mesh.meshlets) &&
+                   writeArray(file, mesh.meshletVertices) &&
+                   writeArray(file, mesh.meshletTriangles);
+    fclose(file);
+    if (!success) {
+        cerr << "Failed to write mesh cache " << cachePath << "." << endl;
+        remove(cachePath);
+    }
+    return success;
+}
+
+bool loadMeshCache(const char *cachePath, clusteredMesh &out_mesh) {
+    FILE *file = fopen(cachePath, "rb");
+    if (file == NULL) {
+        return false;
+    }
+
+    meshCacheHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, "MESH", 4) != 0 ||
+        header.version != MESH_CACHE_VERSION) {
+        fclose(file);
+        return false;
+    }
+
+    //The arrays fill the rest of the file exactly, so the counts can be checked before anything is allocated for them
+    //The sum can't overflow: every count is 32 bits and every element is only a few bytes
+    unsigned long long expectedSize = sizeof(header) +
+        (unsigned long long)header.vertexCount * (sizeof(glm::vec3) + sizeof(glm::vec2) + sizeof(glm::vec3)) +
+        (unsigned long long)header.indexCount * sizeof(unsigned int) +
+        (unsigned long long)header.meshletCount * sizeof(meshlet) +
+        (unsigned long long)header.meshletVertexCount * sizeof(unsigned int) +
+        (unsigned long long)header.meshletTriangleCount * 3;
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, sizeof(header), SEEK_SET);
+    if (fileSize < 0 || (unsigned long long)fileSize != expectedSize) {
+        cerr << "Mesh cache " << cachePath << " doesn't match its header." << endl;
+        fclose(file);
+        return false;
+    }
+
+    bool success = readArray(file, out_mesh.positions, header.vertexCount) &&
+                   readArray(file, out_mesh.uvs, header.vertexCount) &&
+                   readArray(file, out_mesh.normals, header.vertexCount) &&
+                   readArray(file, out_mesh.indices, header.indexCount) &&
+                   readArray(file, out_mesh.meshlets, header.meshletCount) &&
+                   readArray(file, out_mesh.meshletVertices, header.meshletVertexCount) &&
+                   readArray(file, out_mesh.meshletTriangles, size_t(header.meshletTriangleCount) * 3);
+    fclose(file);
+    if (!success) {
+        cerr << "Mesh cache " << cachePath << " is truncated." << endl;
+        return false;
+    }
+    if (!validateMesh(out_mesh)) {
+        cerr << "Mesh cache " << cachePath << " holds out of range indices." << endl;
+        return false;
+    }
+    return true;
+}
+
+bool buildMesh(const char *objPath, clusteredMesh &out_mesh) {
+    objloader loader;
+    vector<glm::vec3> vertices;
+    vector<glm::vec2> uvs;
+    vector<glm::vec3> normals;
+    if (!loader.loadOBJ(objPath, vertices, uvs, normals)) {
+        return false;
+    }
+    out_mesh = clusteredMesh();
+    indexMesh(vertices, uvs, normals, out_mesh);
+    buildMeshlets(out_mesh);
+    return true;
+}
+
+bool loadMesh(const char *objPath, const char *cachePath, clusteredMesh &out_mesh) {
+    //Use the cache as long as it is at least as new as the OBJ
+    struct stat objStat, cacheStat;
+    if (stat(objPath, &objStat) == 0 && stat(cachePath, &cacheStat) == 0 &&
+        cacheStat.st_mtime >= objStat.st_mtime &&
+        loadMeshCache(cachePath, out_mesh)) {
+        return true;
+    }
+
+    if (!buildMesh(objPath, out_mesh)) {
+        return false;
+    }
+    saveMeshCache(cachePath, out_mesh);
+    return true;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "meshlet.h"
+
+//Binary mesh cache: an indexed, clustered mesh written out exactly as it sits in memory so that loading it is one read per array
+//The layout follows this platform's struct layout, so cache files are not meant to be shared between machines
+#define MESH_CACHE_VERSION 1
+
+bool saveMeshCache(const char *cachePath, const clusteredMesh &mesh);
+//Returns false if the file is missing, from another version, or its counts and indices don't hold together
+bool loadMeshCache(const char *cachePath, clusteredMesh &out_mesh);
+
+//Parses, indexes and clusters an OBJ without touching the cache
+bool buildMesh(const char *objPath, clusteredMesh &out_mesh);
+
+//Loads the OBJ through the cache: if the cache file is missing or older than the OBJ, the OBJ is parsed, indexed, clustered and the cache is rewritten
+bool loadMesh(const char *objPath, const char *cachePath, clusteredMesh &out_mesh);
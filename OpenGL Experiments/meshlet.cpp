@@ -0,0 +1,306 @@
+#include "meshlet.h"
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+
+//A face corner, compared and hashed as raw bytes (it is all floats, so there is no padding to worry about)
+struct packedVertex {
+    glm::vec3 position;
+    glm::vec2 uv;
+    glm::vec3 normal;
+    bool operator==(const packedVertex &other) const {
+        return memcmp(this, &other, sizeof(packedVertex)) == 0;
+    }
+};
+
+struct packedVertexHash {
+    size_t operator()(const packedVertex &v) const {
+        //FNV-1a
+        const unsigned char *bytes = reinterpret_cast<const unsigned char*>(&v);
+        size_t hash = 2166136261u;
+        for (size_t i = 0; i < sizeof(packedVertex); i++) {
+            hash = (hash ^ bytes[i]) * 16777619u;
+        }
+        return hash;
+    }
+};
+
+void indexMesh(const std::vector<glm::vec3> &vertices,
+               const std::vector<glm::vec2> &uvs,
+               const std::vector<glm::vec3> &normals,
+               clusteredMesh &out_mesh) {
+    std::unordered_map<packedVertex, unsigned int, packedVertexHash> lookup;
+    lookup.reserve(vertices.size());
+    out_mesh.indices.reserve(vertices.size());
+
+    for (size_t i = 0; i < vertices.size(); i++) {
+        packedVertex v;
+        v.position = vertices[i];
+        v.uv = uvs[i];
+        v.normal = normals[i];
+
+        std::unordered_map<packedVertex, unsigned int, packedVertexHash>::iterator found = lookup.find(v);
+        if (found != lookup.end()) {
+            out_mesh.indices.push_back(found->second);
+            continue;
+        }
+        unsigned int index = (unsigned int)out_mesh.positions.size();
+        lookup[v] = index;
+        out_mesh.positions.push_back(v.position);
+        out_mesh.uvs.push_back(v.uv);
+        out_mesh.normals.push_back(v.normal);
+        out_mesh.indices.push_back(index);
+    }
+}
+
+//Fills in the bounding sphere and normal cone of one meshlet
+static void computeMeshletBounds(const clusteredMesh &mesh, meshlet &m) {
+    std::vector<glm::vec3> points(m.vertexCount);
+    for (unsigned int i = 0; i < m.vertexCount; i++) {
+        points[i] = mesh.positions[mesh.meshletVertices[m.vertexOffset + i]];
+    }
+    m.sphere = computeBoundingSphere(points);
+    glm::vec3 center(m.sphere.x, m.sphere.y, m.sphere.z);
+
+    //Face normals (degenerate triangles don't face anywhere, so they are skipped)
+    std::vector<glm::vec3> faceNormals;
+    std::vector<glm::vec3> facePoints;
+    faceNormals.reserve(m.triangleCount);
+    facePoints.reserve(m.triangleCount);
+    glm::vec3 axis(0.0f);
+    for (unsigned int i = 0; i < m.triangleCount; i++) {
+        const unsigned char *triangle = &mesh.meshletTriangles[(m.triangleOffset + i) * 3];
+        glm::vec3 a = points[triangle[0]];
+        glm::vec3 b = points[triangle[1]];
+        glm::vec3 c = points[triangle[2]];
+        glm::vec3 normal = glm::cross(b - a, c - a);
+        float area = glm::length(normal);
+        if (area <= 1e-12f) {
+            continue;
+        }
+        normal /= area;
+        faceNormals.push_back(normal);
+        facePoints.push_back(a);
+        axis += normal;
+    }
+
+    //Default to a cone that never rejects anything
+    m.coneApex = center;
+    m.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    m.coneCutoff = 1.0f;
+    float axisLength = glm::length(axis);
+    if (faceNormals.empty() || axisLength <= 1e-6f) {
+        return;
+    }
+    axis /= axisLength;
+
+    //The widest angle between the axis and any normal; past ~84 degrees the cone is too wide to be worth testing
+    float minimumDot = 1.0f;
+    for (size_t i = 0; i < faceNormals.size(); i++) {
+        minimumDot = std::min(minimumDot, glm::dot(faceNormals[i], axis));
+    }
+    if (minimumDot <= 0.1f) {
+        return;
+    }
+
+    //Slide the apex back along the axis until it is behind every triangle's plane, so the test is valid for viewers close to the cluster too
+    float maximumT = 0.0f;
+    for (size_t i = 0; i < faceNormals.size(); i++) {
+        float t = glm::dot(center - facePoints[i], faceNormals[i]) / glm::dot(axis, faceNormals[i]);
+        maximumT = std::max(maximumT, t);
+    }
+    m.coneApex = center - axis * maximumT;
+    m.coneAxis = axis;
+    m.coneCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+}
+
+void buildMeshlets(clusteredMesh &mesh) {
+    mesh.meshlets.clear();
+    mesh.meshletVertices.clear();
+    mesh.meshletTriangles.clear();
+
+    size_t triangleCount = mesh.indices.size() / 3;
+    size_t vertexCount = mesh.positions.size();
+
+    //Vertex -> triangle adjacency, stored as one flat array with an offset per vertex
+    std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++) {
+        adjacencyOffsets[mesh.indices[i] + 1]++;
+    }
+    for (size_t i = 0; i < vertexCount; i++) {
+        adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+    }
+    std::vector<unsigned int> adjacency(triangleCount * 3);
+    std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t i = 0; i < triangleCount * 3; i++) {
+        adjacency[fill[mesh.indices[i]]++] = (unsigned int)(i / 3);
+    }
+
+    std::vector<glm::vec3> centroids(triangleCount);
+    for (size_t i = 0; i < triangleCount; i++) {
+        centroids[i] = (mesh.positions[mesh.indices[i * 3]] + mesh.positions[mesh.indices[i * 3 + 1]] + mesh.positions[mesh.indices[i * 3 + 2]]) / 3.0f;
+    }
+
+    //Maps a mesh vertex to its slot in the meshlet being built (0xff = not in it yet)
+    std::vector<unsigned char> localIndex(vertexCount, 0xff);
+    std::vector<bool> emitted(triangleCount, false);
+    size_t seed = 0;
+
+    while (true) {
+        //Every meshlet starts from the first triangle (in index order) that hasn't been used yet
+        while (seed < triangleCount && emitted[seed]) {
+            seed++;
+        }
+        if (seed == triangleCount) {
+            break;
+        }
+
+        meshlet current = meshlet();
+        current.vertexOffset = (unsigned int)mesh.meshletVertices.size();
+        current.triangleOffset = (unsigned int)(mesh.meshletTriangles.size() / 3);
+        glm::vec3 centroidSum(0.0f);
+        size_t next = seed;
+
+        //Grow it one triangle at a time, always taking a neighbour that adds the fewest new vertices (the one nearest the middle on ties) so meshlets stay compact and their normal cones narrow
+        while (true) {
+            const unsigned int *triangle = &mesh.indices[next * 3];
+            for (int j = 0; j < 3; j++) {
+                if (localIndex[triangle[j]] == 0xff) {
+                    localIndex[triangle[j]] = (unsigned char)current.vertexCount++;
+                    mesh.meshletVertices.push_back(triangle[j]);
+                }
+                mesh.meshletTriangles.push_back(localIndex[triangle[j]]);
+            }
+            emitted[next] = true;
+            current.triangleCount++;
+            centroidSum += centroids[next];
+            if (current.triangleCount == MESHLET_MAX_TRIANGLES) {
+                break;
+            }
+
+            glm::vec3 center = centroidSum / float(current.triangleCount);
+            size_t best = triangleCount;
+            unsigned int bestNewVertices = 4;
+            float bestDistance = 0.0f;
+            for (unsigned int v = 0; v < current.vertexCount; v++) {
+                unsigned int vertex = mesh.meshletVertices[current.vertexOffset + v];
+                for (unsigned int k = adjacencyOffsets[vertex]; k < adjacencyOffsets[vertex + 1]; k++) {
+                    unsigned int candidate = adjacency[k];
+                    if (emitted[candidate]) {
+                        continue;
+                    }
+                    const unsigned int *c = &mesh.indices[candidate * 3];
+                    unsigned int newVertices = (localIndex[c[0]] == 0xff) + (localIndex[c[1]] == 0xff && c[1] != c[0]) + (localIndex[c[2]] == 0xff && c[2] != c[0] && c[2] != c[1]);
+                    if (current.vertexCount + newVertices > MESHLET_MAX_VERTICES) {
+                        continue;
+                    }
+                    float distance = glm::length(centroids[candidate] - center);
+                    if (newVertices < bestNewVertices || (newVertices == bestNewVertices && distance < bestDistance)) {
+                        best = candidate;
+                        bestNewVertices = newVertices;
+                        bestDistance = distance;
+                    }
+                }
+            }
+            if (best == triangleCount) {
+                break;
+            }
+            next = best;
+        }
+
+        for (unsigned int j = 0; j < current.vertexCount; j++) {
+            localIndex[mesh.meshletVertices[current.vertexOffset + j]] = 0xff;
+        }
+        computeMeshletBounds(mesh, current);
+        mesh.meshlets.push_back(current);
+    }
+}
+
+void cullMeshlets(const clusteredMesh &mesh,
+                  const glm::mat4 &model,
+                  const frustum &viewFrustum,
+                  const glm::vec3 &cameraPosition,
+                  meshletCullStats &stats,
+                  std::vector<unsigned int> *out_visible) {
+    for (size_t i = 0; i < mesh.meshlets.size(); i++) {
+        const meshlet &m = mesh.meshlets[i];
+        stats.meshlets++;
+        stats.triangles += m.triangleCount;
+
+        if (!sphereInFrustum(viewFrustum, transformBoundingSphere(m.sphere, model))) {
+            stats.frustumRejectedMeshlets++;
+            stats.frustumRejectedTriangles += m.triangleCount;
+            continue;
+        }
+
+        if (m.coneCutoff < 1.0f) {
+            glm::vec4 apex = model * glm::vec4(m.coneApex, 1.0f);
+            glm::vec4 axis = model * glm::vec4(m.coneAxis, 0.0f);
+            glm::vec3 toApex = glm::vec3(apex.x, apex.y, apex.z) - cameraPosition;
+            float distance = glm::length(toApex);
+            if (distance > 0.0f &&
+                glm::dot(toApex / distance, glm::normalize(glm::vec3(axis.x, axis.y, axis.z))) >= m.coneCutoff) {
+                stats.backfaceRejectedMeshlets++;
+                stats.backfaceRejectedTriangles += m.triangleCount;
+                continue;
+            }
+        }
+
+        if (out_visible != NULL) {
+            out_visible->push_back((unsigned int)i);
+        }
+    }
+}
+
+void printMeshletCullingReport(const char *name, const clusteredMesh &mesh) {
+    glm::vec4 sphere = computeBoundingSphere(mesh.positions);
+    glm::vec3 center(sphere.x, sphere.y, sphere.z);
+    float radius = std::max(sphere.w, 1e-3f);
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, radius * 0.01f, radius * 10.0f);
+
+    printf("%s: %zu triangles in %zu meshlets (%.1f triangles / %.1f vertices per meshlet)\n",
+           name,
+           mesh.indices.size() / 3,
+           mesh.meshlets.size(),
+           mesh.meshlets.empty() ? 0.0 : double(mesh.indices.size() / 3) / mesh.meshlets.size(),
+           mesh.meshlets.empty() ? 0.0 : double(mesh.meshletVertices.size()) / mesh.meshlets.size());
+    printf("%-22s %10s %10s %10s\n", "view", "frustum", "backface", "total");
+
+    //Eight views around the mesh from far enough away to see all of it, then the same again from up close where the frustum does more of the work
+    meshletCullStats total;
+    memset(&total, 0, sizeof(total));
+    for (int view = 0; view < 16; view++) {
+        bool close = view >= 8;
+        float angle = glm::pi<float>() * 2.0f * (view % 8) / 8.0f;
+        float distance = radius * (close ? 1.5f : 3.0f);
+        glm::vec3 eye = center + glm::vec3(std::sin(angle), 0.35f, std::cos(angle)) * distance;
+        glm::mat4 viewMatrix = glm::lookAt(eye, center, glm::vec3(0.0f, 1.0f, 0.0f));
+
+        meshletCullStats stats;
+        memset(&stats, 0, sizeof(stats));
+        cullMeshlets(mesh, glm::mat4(1.0f), extractFrustum(projection * viewMatrix), eye, stats, NULL);
+
+        char label[32];
+        snprintf(label, sizeof(label), "%s %3d deg", close ? "near" : "far ", (view % 8) * 45);
+        double triangles = stats.triangles > 0 ? double(stats.triangles) : 1.0;
+        printf("%-22s %9.1f%% %9.1f%% %9.1f%%\n",
+               label,
+               100.0 * stats.frustumRejectedTriangles / triangles,
+               100.0 * stats.backfaceRejectedTriangles / triangles,
+               100.0 * (stats.frustumRejectedTriangles + stats.backfaceRejectedTriangles) / triangles);
+
+        total.triangles += stats.triangles;
+        total.frustumRejectedTriangles += stats.frustumRejectedTriangles;
+        total.backfaceRejectedTriangles += stats.backfaceRejectedTriangles;
+    }
+    double triangles = total.triangles > 0 ? double(total.triangles) : 1.0;
+    printf("%-22s %9.1f%% %9.1f%% %9.1f%%\n",
+           "average",
+           100.0 * total.frustumRejectedTriangles / triangles,
+           100.0 * total.backfaceRejectedTriangles / triangles,
+           100.0 * (total.frustumRejectedTriangles + total.backfaceRejectedTriangles) / triangles);
+}
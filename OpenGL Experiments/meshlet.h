@@ -0,0 +1,70 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "culling.h"
+
+//Upper limits for a single cluster: 64 / 124 keeps the local triangle list a multiple of 4 bytes and fits mesh shader hardware as well
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+//A small cluster of triangles that can be culled on its own
+//Vertices are stored as indices into the mesh's vertex arrays; triangles as three local (8-bit) indices into the meshlet's own vertex list
+struct meshlet {
+    unsigned int    vertexOffset;
+    unsigned int    vertexCount;
+    unsigned int    triangleOffset;
+    unsigned int    triangleCount;
+
+    //Bounding sphere: (center, radius)
+    glm::vec4       sphere;
+
+    //Normal cone: every triangle faces away from a viewer for which dot(normalize(coneApex - viewer), coneAxis) >= coneCutoff
+    //A cutoff of 1 means the triangles point in too many directions for the cone to ever reject the cluster
+    glm::vec3       coneApex;
+    glm::vec3       coneAxis;
+    float           coneCutoff;
+};
+
+//An indexed mesh split into meshlets
+struct clusteredMesh {
+    std::vector<glm::vec3>      positions;
+    std::vector<glm::vec2>      uvs;
+    std::vector<glm::vec3>      normals;
+    std::vector<unsigned int>   indices;
+    std::vector<meshlet>        meshlets;
+    std::vector<unsigned int>   meshletVertices;
+    std::vector<unsigned char>  meshletTriangles;
+};
+
+//objloader produces one vertex per face corner; this welds identical corners back together and builds an index buffer
+void indexMesh(const std::vector<glm::vec3> &vertices,
+               const std::vector<glm::vec2> &uvs,
+               const std::vector<glm::vec3> &normals,
+               clusteredMesh &out_mesh);
+
+//Partitions the index buffer of the mesh into meshlets of neighbouring triangles and computes their bounds
+void buildMeshlets(clusteredMesh &mesh);
+
+//Counters filled in by cullMeshlets
+struct meshletCullStats {
+    size_t          meshlets;
+    size_t          triangles;
+    size_t          frustumRejectedMeshlets;
+    size_t          frustumRejectedTriangles;
+    size_t          backfaceRejectedMeshlets;
+    size_t          backfaceRejectedTriangles;
+};
+
+//Per-cluster frustum and backface-cone test for one instance of the mesh
+//The frustum is in world space; the model matrix is assumed to have a uniform scale so the cone stays valid
+//The indices of the surviving meshlets are appended to out_visible (if given); stats are accumulated, not reset
+void cullMeshlets(const clusteredMesh &mesh,
+                  const glm::mat4 &model,
+                  const frustum &viewFrustum,
+                  const glm::vec3 &cameraPosition,
+                  meshletCullStats &stats,
+                  std::vector<unsigned int> *out_visible);
+
+//Orbits a camera around the mesh and prints how many triangles the cluster culling rejects from each direction
+void printMeshletCullingReport(const char *name, const clusteredMesh &mesh);
@@ -1,4 +1,7 @@
 #include "objloader.h"
+#include "memory.h"
+#include <cstdio>
+#include <cstdlib>
 
 objloader::objloader() {
     
@@ -70,90 +73,158 @@ objloader::objloader() {
     6. f is a face where each of the triplets are a vertex (vertex index, uv index, normal index)
  */
 
+//Advances past spaces and tabs (but not line breaks)
+static const char* skipSpaces(const char *cursor) {
+    while (*cursor == ' ' || *cursor == '\t' || *cursor == '\r') {
+        cursor++;
+    }
+    return cursor;
+}
+
+//Advances to the first character of the next line
+static const char* nextLine(const char *cursor) {
+    while (*cursor != '\0' && *cursor != '\n') {
+        cursor++;
+    }
+    if (*cursor == '\n') {
+        cursor++;
+    }
+    return cursor;
+}
+
+//Parses one "vertex/uv/normal" triplet of a face
+static bool parseFaceVertex(const char *&cursor, unsigned int &vertexIndex, unsigned int &uvIndex, unsigned int &normalIndex) {
+    char *end;
+    cursor = skipSpaces(cursor);
+    vertexIndex = (unsigned int)strtoul(cursor, &end, 10);
+    if (end == cursor || *end != '/') {
+        return false;
+    }
+    cursor = end + 1;
+    uvIndex = (unsigned int)strtoul(cursor, &end, 10);
+    if (end == cursor || *end != '/') {
+        return false;
+    }
+    cursor = end + 1;
+    normalIndex = (unsigned int)strtoul(cursor, &end, 10);
+    if (end == cursor) {
+        return false;
+    }
+    cursor = end;
+    return true;
+}
+
 bool objloader::loadOBJ(const string &filename,
                         vector<glm::vec3> &out_vertices,
                         vector<glm::vec2> &out_uvs,
                         vector<glm::vec3> &out_normals) {
     
-    //Temporary variables for obj contents
-    vector<unsigned int> vertexIndices, uvIndices, normalIndices;
-    vector<glm::vec3> temp_vertices;
-    vector<glm::vec2> temp_uvs;
-    vector<glm::vec3> temp_normals;
+    //Everything temporary lives in the scratch arena and is released when we return
+    arena &scratch = scratchArena();
+    arenaScope scope(scratch);
     
     //Open the file
-    FILE *file = fopen(filename.c_str(), "r");
+    FILE *file = fopen(filename.c_str(), "rb");
     if (file == NULL) {
         cerr << "Failed to open the specifed file." << endl;
         return false;
     }
     
-    while (true) {
-        //We assume the first word of a line won't be longer than 128 characters...not the best solution
-        char lineHeader[128];
-        int res = fscanf(file, "%s", lineHeader);
-        
-        //If we're at the end of the file, quit
-        if (res == EOF) {
-            break;
+    //Read the whole file into memory with a single allocation (plus a terminating NULL so the parser knows where to stop)
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (fileSize < 0) {
+        cerr << "Failed to read the specified file." << endl;
+        fclose(file);
+        return false;
+    }
+    char *fileData = scratch.allocateArray<char>(size_t(fileSize) + 1);
+    size_t bytesRead = fread(fileData, 1, size_t(fileSize), file);
+    fileData[bytesRead] = '\0';
+    fclose(file);
+    
+    //First pass: count everything so that each array below is allocated exactly once
+    size_t vertexCount = 0, uvCount = 0, normalCount = 0, faceCount = 0;
+    for (const char *cursor = fileData; *cursor != '\0'; cursor = nextLine(cursor)) {
+        const char *token = skipSpaces(cursor);
+        if (token[0] == 'v' && (token[1] == ' ' || token[1] == '\t')) {
+            vertexCount++;
+        }
+        else if (token[0] == 'v' && token[1] == 't') {
+            uvCount++;
         }
+        else if (token[0] == 'v' && token[1] == 'n') {
+            normalCount++;
+        }
+        else if (token[0] == 'f' && (token[1] == ' ' || token[1] == '\t')) {
+            faceCount++;
+        }
+    }
+    
+    //Temporary variables for obj contents
+    glm::vec3 *temp_vertices = scratch.allocateArray<glm::vec3>(vertexCount);
+    glm::vec2 *temp_uvs = scratch.allocateArray<glm::vec2>(uvCount);
+    glm::vec3 *temp_normals = scratch.allocateArray<glm::vec3>(normalCount);
+    unsigned int *vertexIndices = scratch.allocateArray<unsigned int>(faceCount * 3);
+    unsigned int *uvIndices = scratch.allocateArray<unsigned int>(faceCount * 3);
+    unsigned int *normalIndices = scratch.allocateArray<unsigned int>(faceCount * 3);
+    vertexCount = uvCount = normalCount = faceCount = 0;
+    
+    //Second pass: parse
+    for (const char *cursor = fileData; *cursor != '\0'; cursor = nextLine(cursor)) {
+        const char *token = skipSpaces(cursor);
+        char *end;
         
-        if (strcmp(lineHeader, "v") == 0) { //Vertices
-            glm::vec3 vertex;
-            fscanf(file, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z);
-            temp_vertices.push_back(vertex);
+        if (token[0] == 'v' && (token[1] == ' ' || token[1] == '\t')) { //Vertices
+            glm::vec3 &vertex = temp_vertices[vertexCount++];
+            vertex.x = strtof(token + 1, &end);
+            vertex.y = strtof(end, &end);
+            vertex.z = strtof(end, &end);
         }
-        else if (strcmp(lineHeader, "vt") == 0) { //UVs
-            glm::vec2 uv;
-            fscanf(file, "%f %f\n", &uv.x, &uv.y);
-            temp_uvs.push_back(uv);
+        else if (token[0] == 'v' && token[1] == 't') { //UVs
+            glm::vec2 &uv = temp_uvs[uvCount++];
+            uv.x = strtof(token + 2, &end);
+            uv.y = strtof(end, &end);
         }
-        else if (strcmp(lineHeader, "vn") == 0) { //Normals
-            glm::vec3 normal;
-            fscanf(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z);
-            temp_normals.push_back(normal);
+        else if (token[0] == 'v' && token[1] == 'n') { //Normals
+            glm::vec3 &normal = temp_normals[normalCount++];
+            normal.x = strtof(token + 2, &end);
+            normal.y = strtof(end, &end);
+            normal.z = strtof(end, &end);
         }
-        else if (strcmp(lineHeader, "f") == 0) {
-            string vertex1, vertex2, vertex3;
-            unsigned int vertexIndex[3], uvIndex[3], normalIndex[3];
-            int matches = fscanf(file, "%d/%d/%d %d/%d/%d %d/%d/%d\n",
-                                 &vertexIndex[0],
-                                 &uvIndex[0],
-                                 &normalIndex[0],
-                                 &vertexIndex[1],
-                                 &uvIndex[1],
-                                 &normalIndex[1],
-                                 &vertexIndex[2],
-                                 &uvIndex[2],
-                                 &normalIndex[2]);
-            if (matches != 9) {
-                cerr << "File can't be parsed." << endl;
-                return false;
-            }
-            vertexIndices.push_back(vertexIndex[0]);
-            vertexIndices.push_back(vertexIndex[1]);
-            vertexIndices.push_back(vertexIndex[2]);
-            uvIndices    .push_back(uvIndex[0]);
-            uvIndices    .push_back(uvIndex[1]);
-            uvIndices    .push_back(uvIndex[2]);
-            normalIndices.push_back(normalIndex[0]);
-            normalIndices.push_back(normalIndex[1]);
-            normalIndices.push_back(normalIndex[2]);
-            
-            for (unsigned int i = 0; i < vertexIndices.size(); i++) {
-                unsigned int vertexIndex = vertexIndices[i];
-                
-                //Objs are indexed starting at 1
-                glm::vec3 vertex = temp_vertices[vertexIndex-1];
-                out_vertices.push_back(vertex);
-                
-                glm::vec2 uv = temp_uvs[vertexIndex-1];
-                out_uvs.push_back(uv);
-                
-                glm::vec3 normal = temp_normals[vertexIndex-1];
-                out_normals.push_back(normal);
+        else if (token[0] == 'f' && (token[1] == ' ' || token[1] == '\t')) {
+            const char *face = token + 1;
+            for (int i = 0; i < 3; i++) {
+                size_t corner = faceCount * 3 + i;
+                if (!parseFaceVertex(face, vertexIndices[corner], uvIndices[corner], normalIndices[corner])) {
+                    cerr << "File can't be parsed." << endl;
+                    return false;
+                }
             }
+            faceCount++;
+        }
+    }
+    
+    //Expand the indexed data into one vertex per face corner
+    out_vertices.reserve(out_vertices.size() + faceCount * 3);
+    out_uvs.reserve(out_uvs.size() + faceCount * 3);
+    out_normals.reserve(out_normals.size() + faceCount * 3);
+    for (size_t i = 0; i < faceCount * 3; i++) {
+        unsigned int vertexIndex = vertexIndices[i];
+        unsigned int uvIndex = uvIndices[i];
+        unsigned int normalIndex = normalIndices[i];
+        
+        //Objs are indexed starting at 1
+        if (vertexIndex == 0 || vertexIndex > vertexCount ||
+            uvIndex == 0 || uvIndex > uvCount ||
+            normalIndex == 0 || normalIndex > normalCount) {
+            cerr << "File contains an out of range index." << endl;
+            return false;
         }
+        out_vertices.push_back(temp_vertices[vertexIndex-1]);
+        out_uvs.push_back(temp_uvs[uvIndex-1]);
+        out_normals.push_back(temp_normals[normalIndex-1]);
     }
     return true;
-}
\ No newline at end of file
+}
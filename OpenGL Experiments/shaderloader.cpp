@@ -0,0 +1,144 @@
+#include "shaderloader.h"
+#include "memory.h"
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+string loadFileToString(const char *filePath) { //Reads a file into memory and returns a string containing that file data
+    string fileData;
+    ifstream stream(filePath, ios::in | ios::binary); //Path and mode
+    if (stream.is_open()) {
+        cout << "Successfully opened file stream." << endl;
+        
+        //Size the string once up front and read the whole file straight into it
+        stream.seekg(0, ios::end);
+        fileData.resize(size_t(stream.tellg()));
+        stream.seekg(0, ios::beg);
+        if (!fileData.empty()) {
+            stream.read(&fileData[0], fileData.size());
+        }
+        stream.close();
+    }
+    else {
+        cerr << "Failed to open file stream." << endl;
+    }
+    return fileData;
+}
+
+//Info logs are short and come in every size, so they share a set of size-class pools rather than going to the system allocator each time
+static sizeClassAllocator& logAllocator() {
+    static sizeClassAllocator instance(MEMORY_LOADER);
+    return instance;
+}
+
+//Prints a shader's info log (if it has one) to cerr
+static void printShaderLog(GLuint shader) {
+    GLint maxLength = 0;
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &maxLength);
+    if (maxLength <= 0) {
+        return;
+    }
+    
+    // The maxLength includes the NULL character
+    GLchar *errorLog = static_cast<GLchar*>(logAllocator().allocate(maxLength));
+    if (errorLog == NULL) {
+        return;
+    }
+    glGetShaderInfoLog(shader, maxLength, NULL, errorLog);
+    cerr << errorLog;
+    logAllocator().release(errorLog, maxLength);
+}
+
+//Should change these to std::string and use string.c_str() when needed (i.e. for fopen)
+GLuint loadShaders(const char *vertShaderPath, const char *fragShaderPath) {
+    GLuint vertShader = glCreateShader(GL_VERTEX_SHADER); //Create IDs for our shaders
+    GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER); //Create IDs for our shaders
+    
+    string vertShaderSource = loadFileToString(vertShaderPath);
+    string fragShaderSource = loadFileToString(fragShaderPath);
+    
+    //glShaderSource requires C-style string parameters, so we do the conversion here
+    const char *rawVertShaderSource = vertShaderSource.c_str();
+    const char *rawFragShaderSource = fragShaderSource.c_str();
+    
+    glShaderSource(vertShader, 1, &rawVertShaderSource, NULL);
+    glShaderSource(fragShader, 1, &rawFragShaderSource, NULL);
+    
+    //VERTEX SHADER
+    glCompileShader(vertShader);
+    GLint success = 0;
+    glGetShaderiv(vertShader, GL_COMPILE_STATUS, &success);
+    
+    //Error logging
+    if (success == GL_FALSE) {
+        cerr << "Error compiling vertex shader." << endl;
+        printShaderLog(vertShader);
+        // Provide the infolog in whatever manor you deem best.
+        // Exit with failure.
+        glDeleteShader(vertShader); // Don't leak the shader.
+    }
+    
+    //FRAGMENT SHADER
+    glCompileShader(fragShader);
+    success = 0;
+    glGetShaderiv(fragShader, GL_COMPILE_STATUS, &success);
+    
+    //Error logging
+    if (success == GL_FALSE) {
+        cerr << "Error compiling fragment shader." << endl;
+        printShaderLog(fragShader);
+        // Provide the infolog in whatever manor you deem best.
+        // Exit with failure.
+        glDeleteShader(fragShader); // Don't leak the shader.
+    }
+    
+    GLuint program = glCreateProgram(); //Create a program
+    glAttachShader(program, vertShader); //Attach shaders
+    glAttachShader(program, fragShader); //Attach shaders
+    glLinkProgram(program); //We are going to use this program in our application
+    
+    cout << "Successfully loaded shader sources." << endl;
+    
+    return program;
+}
+
+GLuint compileShader(GLenum type, const char *shaderPath) {
+    GLuint shader = glCreateShader(type); //Create an ID for our shader
+    
+    string shaderSource = loadFileToString(shaderPath);
+    const char *rawShaderSource = shaderSource.c_str();
+    glShaderSource(shader, 1, &rawShaderSource, NULL);
+    
+    glCompileShader(shader);
+    GLint success = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    
+    //Error logging
+    if (success == GL_FALSE) {
+        cerr << "Error compiling shader " << shaderPath << "." << endl;
+        printShaderLog(shader);
+        glDeleteShader(shader); // Don't leak the shader.
+        return 0;
+    }
+    return shader;
+}
+
+GLuint loadComputeShader(const char *compShaderPath) {
+    GLuint compShader = compileShader(GL_COMPUTE_SHADER, compShaderPath);
+    if (compShader == 0) {
+        return 0;
+    }
+    
+    GLuint program = glCreateProgram();
+    glAttachShader(program, compShader);
+    glLinkProgram(program);
+    
+    //The program keeps what it needs, so the shader object can go
+    glDeleteShader(compShader);
+    
+    cout << "Successfully loaded compute shader source." << endl;
+    
+    return program;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <string>
+
+//Reads a file into memory and returns a string containing that file data
+std::string loadFileToString(const char *filePath);
+
+//Compiles a single shader stage and prints its info log on failure; returns 0 on failure
+GLuint compileShader(GLenum type, const char *shaderPath);
+
+//Compiles and links a vertex + fragment shader pair
+GLuint loadShaders(const char *vertShaderPath, const char *fragShaderPath);
+
+//Compiles and links a single compute shader (requires OpenGL 4.3); returns 0 on failure
+GLuint loadComputeShader(const char *compShaderPath);
@@ -0,0 +1,326 @@
+#include "streamingselftest.h"
+#include "texturecache.h"
+#include "memory.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+/*
+ *
+ * recordingTextureBackend
+ *
+ */
+
+recordingTextureBackend::recordedTexture& recordingTextureBackend::getTexture(GLuint texture) {
+    if (texture == 0 || texture > textures.size()) {
+        cerr << "The streamer used texture " << texture << ", which it never created." << endl;
+        exit(1);
+    }
+    return textures[texture - 1];
+}
+
+GLuint recordingTextureBackend::createTexture(int levelCount) {
+    recordedTexture tex;
+    tex.baseLevel = 0;
+    tex.defined.assign(levelCount, false);
+    textures.push_back(tex);
+    return GLuint(textures.size());
+}
+
+void recordingTextureBackend::destroyTexture(GLuint texture) {
+    recordedTexture &tex = getTexture(texture);
+    tex.defined.assign(tex.defined.size(), false);
+}
+
+void recordingTextureBackend::uploadLevel(GLuint texture, int level, int width, int height, const unsigned char *pixels) {
+    (void)width;
+    (void)height;
+    (void)pixels;
+    recordedTexture &tex = getTexture(texture);
+    tex.defined[level] = true;
+    call c = { CALL_UPLOAD, texture, level };
+    calls.push_back(c);
+}
+
+void recordingTextureBackend::releaseLevel(GLuint texture, int level) {
+    recordedTexture &tex = getTexture(texture);
+    if (level >= tex.baseLevel) {
+        cerr << "Level " << level << " of texture " << texture << " was released while still being sampled." << endl;
+        errors++;
+    }
+    tex.defined[level] = false;
+    call c = { CALL_RELEASE, texture, level };
+    calls.push_back(c);
+}
+
+void recordingTextureBackend::setBaseLevel(GLuint texture, int baseLevel) {
+    recordedTexture &tex = getTexture(texture);
+    tex.baseLevel = baseLevel;
+    for (size_t level = baseLevel; level < tex.defined.size(); level++) {
+        if (!tex.defined[level]) {
+            cerr << "Texture " << texture << " samples from level " << baseLevel << " but level " << level << " isn't defined." << endl;
+            errors++;
+            break;
+        }
+    }
+    call c = { CALL_BASE_LEVEL, texture, baseLevel };
+    calls.push_back(c);
+}
+
+/*
+ *
+ * runStreamingSelfTest
+ *
+ */
+
+#define SELFTEST_CACHE_PATH "streamingselftest.tex"
+#define SELFTEST_SIZE 512
+
+static size_t failedChecks;
+
+static void check(bool condition, const char *what) {
+    printf("%s: %s\n", condition ? "pass" : "FAIL", what);
+    if (!condition) {
+        failedChecks++;
+    }
+}
+
+//The levels touched by calls of one type since the given call, for one texture (or any texture if it is 0)
+static vector<int> getCallLevels(const recordingTextureBackend &backend, size_t firstCall,
+                                 recordingTextureBackend::callType type, GLuint texture) {
+    vector<int> levels;
+    for (size_t i = firstCall; i < backend.calls.size(); i++) {
+        const recordingTextureBackend::call &c = backend.calls[i];
+        if (c.type == type && (texture == 0 || c.texture == texture)) {
+            levels.push_back(c.level);
+        }
+    }
+    return levels;
+}
+
+static void runFrame(textureStreamer &streamer) {
+    frameArena().reset();
+    streamer.update();
+}
+
+static bool isClose(float value, float expected) {
+    return fabs(value - expected) < 1e-4f;
+}
+
+static size_t getLevelBytes(int level) {
+    size_t size = getMipSize(SELFTEST_SIZE, level);
+    return size * size * STREAMING_BYTES_PER_TEXEL;
+}
+
+bool runStreamingSelfTest() {
+    failedChecks = 0;
+
+    //The checks only look at which levels move, so a flat grey image will do
+    {
+        arena &scratch = scratchArena();
+        arenaScope scope(scratch);
+        image img;
+        img.width = SELFTEST_SIZE;
+        img.height = SELFTEST_SIZE;
+        img.pixels = scratch.allocateArray<unsigned char>(SELFTEST_SIZE * SELFTEST_SIZE * 3);
+        memset(img.pixels, 128, SELFTEST_SIZE * SELFTEST_SIZE * 3);
+        if (!saveTextureCache(SELFTEST_CACHE_PATH, img)) {
+            cerr << "Failed to write " << SELFTEST_CACHE_PATH << " for the streaming self test." << endl;
+            return false;
+        }
+    }
+    int tailLevel = 0;
+    while (getMipSize(SELFTEST_SIZE, tailLevel) > STREAMING_TAIL_SIZE) {
+        tailLevel++;
+    }
+    int levelCount = 1;
+    while (getMipSize(SELFTEST_SIZE, levelCount - 1) > 1) {
+        levelCount++;
+    }
+    size_t tailBytes = 0;
+    for (int level = tailLevel; level < levelCount; level++) {
+        tailBytes += getLevelBytes(level);
+    }
+
+    //UV density: a unit square mapped onto the whole texture has one unit of UV area per unit of world area
+    {
+        vector<glm::vec3> positions;
+        vector<glm::vec2> uvs;
+        glm::vec3 corners[] = { glm::vec3(0, 0, 0), glm::vec3(1, 0, 0), glm::vec3(1, 1, 0), glm::vec3(0, 0, 0), glm::vec3(1, 1, 0), glm::vec3(0, 1, 0) };
+        for (int i = 0; i < 6; i++) {
+            positions.push_back(corners[i]);
+            uvs.push_back(glm::vec2(corners[i].x, corners[i].y));
+        }
+        check(isClose(computeUVDensity(positions, uvs), 1.0f), "a unit square mapped onto the whole texture has a UV density of 1");
+        for (int i = 0; i < 6; i++) {
+            positions[i] *= 2.0f;
+        }
+        check(isClose(computeUVDensity(positions, uvs), 0.25f), "doubling the square's size quarters its UV density");
+    }
+
+    //Mip estimate: with projectionScale 1 (a 90 degree field of view) a viewport 512 pixels high is 2 * distance / 512 units per pixel,
+    //so at distance 0.5 one texel of the 512x512 texture lands on one pixel, and every doubling of the distance is one level coarser
+    check(isClose(estimateMipLevel(SELFTEST_SIZE, SELFTEST_SIZE, 1.0f, 0.5f, 1.0f, 512), 0.0f) &&
+          isClose(estimateMipLevel(SELFTEST_SIZE, SELFTEST_SIZE, 1.0f, 1.0f, 1.0f, 512), 1.0f) &&
+          isClose(estimateMipLevel(SELFTEST_SIZE, SELFTEST_SIZE, 1.0f, 4.0f, 1.0f, 512), 3.0f),
+          "one texel per pixel is level 0, and each doubling of the distance adds a level");
+    check(isClose(estimateMipLevel(SELFTEST_SIZE, SELFTEST_SIZE, 0.25f, 1.0f, 1.0f, 512), 0.0f),
+          "a quarter of the UV density makes up for twice the distance");
+
+    //Clamping: closer than one texel per pixel asks for a negative level and far away asks for more levels than there are
+    //The estimate is left unclamped; requestLevel() clamps it to the levels the texture has
+    {
+        recordingTextureBackend backend;
+        textureStreamer streamer(backend, tailBytes, 0);
+        int a = streamer.addTexture(SELFTEST_CACHE_PATH);
+        float nearLevel = estimateMipLevel(SELFTEST_SIZE, SELFTEST_SIZE, 1.0f, 0.125f, 1.0f, 512);
+        float farLevel = estimateMipLevel(SELFTEST_SIZE, SELFTEST_SIZE, 1.0f, 4096.0f, 1.0f, 512);
+        check(isClose(nearLevel, -2.0f) && isClose(farLevel, 13.0f), "the estimate itself is not clamped");
+        if (a >= 0) {
+            streamer.requestLevel(a, nearLevel);
+            runFrame(streamer);
+            int nearNeeded = streamer.getNeededLevel(a);
+            streamer.requestLevel(a, farLevel);
+            runFrame(streamer);
+            check(nearNeeded == 0 && streamer.getNeededLevel(a) == levelCount - 1, "requested levels are clamped to the texture's mip chain at both ends");
+        }
+    }
+
+    //Tail pinning: the only way to fit A's first streamed level would be to evict B's idle tail, so the load is denied instead
+    {
+        recordingTextureBackend backend;
+        textureStreamer streamer(backend, 2 * tailBytes + getLevelBytes(tailLevel - 1) / 2, 0);
+        int a = streamer.addTexture(SELFTEST_CACHE_PATH);
+        int b = streamer.addTexture(SELFTEST_CACHE_PATH);
+        check(a >= 0 && b >= 0 && streamer.getResidentLevel(a) == tailLevel && streamer.getResidentLevel(b) == tailLevel,
+              "the mip tail is resident as soon as a texture is added");
+        if (a >= 0 && b >= 0) {
+            streamer.requestLevel(a, 0.0f);
+            runFrame(streamer);
+            check(streamer.getResidentLevel(a) == tailLevel && streamer.getStats().deniedLoads == 1, "a load that can't fit in the budget is denied");
+            check(getCallLevels(backend, 0, recordingTextureBackend::CALL_RELEASE, 0).empty(), "the mip tail is never evicted to make room");
+        }
+        check(backend.errors == 0, "no level is sampled while undefined or released while sampled");
+    }
+
+    //Thrashing: room for the tails and one level 0, but a texture streaming towards level 0 already holds its own levels 1 and 2
+    //So level 0 only fits by evicting the other texture's levels as well as ones needed this frame; asking for level 0 of A and B in turn
+    //must be denied without evicting anything, rather than throwing away the other texture's levels for a load that can't happen
+    {
+        recordingTextureBackend backend;
+        textureStreamer streamer(backend, 2 * tailBytes + getLevelBytes(0), 0);
+        int a = streamer.addTexture(SELFTEST_CACHE_PATH);
+        int b = streamer.addTexture(SELFTEST_CACHE_PATH);
+        if (a >= 0 && b >= 0) {
+            for (int round = 0; round < 4; round++) {
+                int handle = round % 2 == 0 ? a : b;
+                for (int frame = 0; frame < tailLevel + 1; frame++) {
+                    streamer.requestLevel(handle, 0.0f);
+                    runFrame(streamer);
+                }
+            }
+            streamingStats stats = streamer.getStats();
+            check(streamer.getResidentLevel(a) == 1 && streamer.getResidentLevel(b) == 1 && stats.deniedLoads > 0,
+                  "a load that idle levels can't make room for is denied");
+            check(getCallLevels(backend, 0, recordingTextureBackend::CALL_RELEASE, 0).empty() && stats.evictions == 0 &&
+                  stats.uploads == size_t(2 * (tailLevel - 1)),
+                  "a denied load evicts nothing, so alternating requests don't reload the same levels");
+        }
+        check(backend.errors == 0, "no level is sampled while undefined or released while sampled");
+    }
+
+    //Room for the three tails, all of A and one more level 2
+    recordingTextureBackend backend;
+    size_t budget = 3 * tailBytes + getLevelBytes(0) + getLevelBytes(1) + 2 * getLevelBytes(2);
+    textureStreamer streamer(backend, budget, 0);
+    int a = streamer.addTexture(SELFTEST_CACHE_PATH);
+    int b = streamer.addTexture(SELFTEST_CACHE_PATH);
+    int c = streamer.addTexture(SELFTEST_CACHE_PATH);
+    if (a < 0 || b < 0 || c < 0) {
+        check(false, "the mip tail is resident as soon as a texture is added");
+        remove(SELFTEST_CACHE_PATH);
+        return false;
+    }
+
+    //Streaming in: one level per update, each one finer than the last
+    size_t firstCall = backend.calls.size();
+    for (int frame = 0; frame < tailLevel; frame++) {
+        streamer.requestLevel(a, 0.0f);
+        runFrame(streamer);
+    }
+    vector<int> uploaded = getCallLevels(backend, firstCall, recordingTextureBackend::CALL_UPLOAD, streamer.getTexture(a));
+    vector<int> expected;
+    for (int level = tailLevel - 1; level >= 0; level--) {
+        expected.push_back(level);
+    }
+    check(uploaded == expected && streamer.getResidentLevel(a) == 0, "levels stream in one per update, coarsest first");
+
+    //Eviction order: B takes the last free level, so C's load has to evict; A stopped being needed before B did, so A loses its finest level
+    streamer.requestLevel(b, 2.0f);
+    runFrame(streamer);
+    check(streamer.getResidentLevel(b) == 2 && streamer.getStats().evictions == 0, "a load that fits evicts nothing");
+    firstCall = backend.calls.size();
+    streamer.requestLevel(c, 2.0f);
+    runFrame(streamer);
+    vector<int> released = getCallLevels(backend, firstCall, recordingTextureBackend::CALL_RELEASE, 0);
+    vector<int> releasedFromA = getCallLevels(backend, firstCall, recordingTextureBackend::CALL_RELEASE, streamer.getTexture(a));
+    check(released.size() == 1 && releasedFromA.size() == 1 && releasedFromA[0] == 0 &&
+          streamer.getResidentLevel(a) == 1 && streamer.getResidentLevel(c) == 2,
+          "the least recently needed level is evicted first, and only as much as the load needs");
+
+    //Budget denial: everything is needed this frame, so whatever doesn't fit is denied rather than evicting a level in use
+    //B and C are furthest from what they need, so they go first and A's level 0 no longer fits
+    firstCall = backend.calls.size();
+    size_t deniedLoads = streamer.getStats().deniedLoads;
+    streamer.requestLevel(a, 0.0f);
+    streamer.requestLevel(b, 0.0f);
+    streamer.requestLevel(c, 0.0f);
+    runFrame(streamer);
+    streamingStats stats = streamer.getStats();
+    check(streamer.getResidentLevel(b) == 1 && streamer.getResidentLevel(c) == 1 && streamer.getResidentLevel(a) == 1 &&
+          stats.deniedLoads == deniedLoads + 1,
+          "a load that would evict a level needed this frame is denied");
+    check(getCallLevels(backend, firstCall, recordingTextureBackend::CALL_RELEASE, 0).empty() && stats.residentBytes <= budget,
+          "a denied load releases nothing and the budget holds");
+
+    //Tail pinning, over the whole run
+    released = getCallLevels(backend, 0, recordingTextureBackend::CALL_RELEASE, 0);
+    bool tailsKept = true;
+    for (size_t i = 0; i < released.size(); i++) {
+        tailsKept = tailsKept && released[i] < tailLevel;
+    }
+    check(tailsKept, "no level of a mip tail is ever evicted");
+    check(backend.errors == 0, "no level is sampled while undefined or released while sampled");
+
+    //Worker threads: the same loads, but read on two workers and only uploaded by the update after they finish
+    {
+        recordingTextureBackend backend;
+        textureStreamer streamer(backend, 3 * (tailBytes + getLevelBytes(0) + getLevelBytes(1) + getLevelBytes(2)), 2);
+        int handles[] = { streamer.addTexture(SELFTEST_CACHE_PATH), streamer.addTexture(SELFTEST_CACHE_PATH), streamer.addTexture(SELFTEST_CACHE_PATH) };
+        for (int frame = 0; frame <= tailLevel; frame++) {
+            for (int i = 0; i < 3; i++) {
+                if (handles[i] >= 0) {
+                    streamer.requestLevel(handles[i], 0.0f);
+                }
+            }
+            runFrame(streamer);
+            streamer.waitForLoads();
+        }
+        bool resident = true;
+        for (int i = 0; i < 3; i++) {
+            resident = resident && handles[i] >= 0 && streamer.getResidentLevel(handles[i]) == 0;
+        }
+        streamingStats stats = streamer.getStats();
+        check(resident && stats.uploads == size_t(3 * tailLevel) && stats.pendingLoads == 0 && stats.evictions == 0,
+              "with worker threads every level streams in once the loads are waited for");
+        check(backend.errors == 0, "no level is sampled while undefined or released while sampled");
+    }
+
+    remove(SELFTEST_CACHE_PATH);
+    printf("Streaming self test: %s\n", failedChecks == 0 ? "PASS" : "FAIL");
+    return failedChecks == 0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+#include "texturestreamer.h"
+
+//A textureBackend that only records what the streamer asks of it, so the residency logic can be checked without a GL context
+//It also flags calls that would be wrong on a real driver: releasing a level that is still sampled, or sampling a level that isn't defined
+class recordingTextureBackend : public textureBackend {
+public:
+    enum callType { CALL_UPLOAD, CALL_RELEASE, CALL_BASE_LEVEL };
+    struct call {
+        callType        type;
+        GLuint          texture;
+        int             level;
+    };
+
+    recordingTextureBackend() : errors(0) {}
+    GLuint          createTexture(int levelCount);
+    void            destroyTexture(GLuint texture);
+    void            uploadLevel(GLuint texture, int level, int width, int height, const unsigned char *pixels);
+    void            releaseLevel(GLuint texture, int level);
+    void            setBaseLevel(GLuint texture, int baseLevel);
+
+    //Every call since the last clear, oldest first
+    std::vector<call> calls;
+    size_t          errors;
+private:
+    struct recordedTexture {
+        int             baseLevel;
+        std::vector<bool> defined;
+    };
+    recordedTexture& getTexture(GLuint texture);
+    std::vector<recordedTexture> textures;
+};
+
+//Checks computeUVDensity and estimateMipLevel against known values, then runs textureStreamer against a recordingTextureBackend
+//and checks tail pinning, streaming order, LRU eviction and budget denial, with and without worker threads
+//Writes a scratch texture cache to the working directory; prints each check and returns false if any failed
+bool runStreamingSelfTest();
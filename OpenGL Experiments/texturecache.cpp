@@ -0,0 +1,176 @@
+#include "texturecache.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+int getMipSize(int size, int level) {
+    size >>= level;
+    return size > 0 ? size : 1;
+}
+
+void downsampleImage(const image &source, image &out_image) {
+    out_image.width = getMipSize(source.width, 1);
+    out_image.height = getMipSize(source.height, 1);
+    for (int y = 0; y < out_image.height; y++) {
+        //Odd sizes (and 1-texel edges) just repeat the last row / column
+        int y0 = min(y * 2, source.height - 1);
+        int y1 = min(y * 2 + 1, source.height - 1);
+        for (int x = 0; x < out_image.width; x++) {
+            int x0 = min(x * 2, source.width - 1);
+            int x1 = min(x * 2 + 1, source.width - 1);
+            const unsigned char *a = source.pixels + (size_t(y0) * source.width + x0) * 3;
+            const unsigned char *b = source.pixels + (size_t(y0) * source.width + x1) * 3;
+            const unsigned char *c = source.pixels + (size_t(y1) * source.width + x0) * 3;
+            const unsigned char *d = source.pixels + (size_t(y1) * source.width + x1) * 3;
+            unsigned char *out = out_image.pixels + (size_t(y) * out_image.width + x) * 3;
+            for (int channel = 0; channel < 3; channel++) {
+                out[channel] = (unsigned char)((a[channel] + b[channel] + c[channel] + d[channel] + 2) / 4);
+            }
+        }
+    }
+}
+
+bool saveTextureCache(const char *cachePath, const image &img) {
+    textureCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "TEXC", 4);
+    header.version = TEXTURE_CACHE_VERSION;
+    header.width = img.width;
+    header.height = img.height;
+
+    //Lay the levels out one after another behind the header
+    unsigned int offset = sizeof(header);
+    for (int level = 0; level < TEXTURE_CACHE_MAX_LEVELS; level++) {
+        header.levelOffsets[level] = offset;
+        header.levelSizes[level] = getMipSize(img.width, level) * getMipSize(img.height, level) * 3;
+        offset += header.levelSizes[level];
+        header.levelCount++;
+        if (getMipSize(img.width, level) == 1 && getMipSize(img.height, level) == 1) {
+            break;
+        }
+    }
+
+    FILE *file = fopen(cachePath, "wb");
+    if (file == NULL) {
+        cerr << "Failed to create texture cache " << cachePath << "." << endl;
+        return false;
+    }
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(img.pixels, 1, header.levelSizes[0], file) == header.levelSizes[0];
+
+    //Each level only needs the one above it, so two buffers are enough
+    vector<unsigned char> previous(img.pixels, img.pixels + header.levelSizes[0]);
+    vector<unsigned char> current;
+    image source = img;
+    for (unsigned int level = 1; success && level < header.levelCount; level++) {
+        source.pixels = &previous[0];
+        current.resize(header.levelSizes[level]);
+        image mip;
+        mip.pixels = &current[0];
+        downsampleImage(source, mip);
+        success = fwrite(mip.pixels, 1, header.levelSizes[level], file) == header.levelSizes[level];
+        previous.swap(current);
+        source.width = mip.width;
+        source.height = mip.height;
+    }
+    fclose(file);
+    if (!success) {
+        cerr << "Failed to write texture cache " << cachePath << "." << endl;
+        remove(cachePath);
+    }
+    return success;
+}
+
+//Everything that reads a level sizes its buffer and the GL upload from the header, so the header has to agree with both the image size and the file
+static bool validateHeader(const textureCacheHeader &header, unsigned long long fileSize) {
+    if (header.width == 0 || header.height == 0 ||
+        header.levelCount == 0 || header.levelCount > TEXTURE_CACHE_MAX_LEVELS) {
+        return false;
+    }
+
+    //No more levels than it takes to get down to 1x1 (counting stops at the cap, which the level count is already under)
+    unsigned int largest = max(header.width, header.height);
+    unsigned int fullChain = 1;
+    while (fullChain < TEXTURE_CACHE_MAX_LEVELS && (largest >> fullChain) > 0) {
+        fullChain++;
+    }
+    if (header.levelCount > fullChain) {
+        return false;
+    }
+
+    //Done in 64 bits, so a huge width or height can't wrap around to a small level size
+    for (unsigned int level = 0; level < header.levelCount; level++) {
+        unsigned long long levelWidth = max(header.width >> level, 1u);
+        unsigned long long levelHeight = max(header.height >> level, 1u);
+        if (header.levelSizes[level] != levelWidth * levelHeight * 3 ||
+            header.levelOffsets[level] < sizeof(header) ||
+            (unsigned long long)header.levelOffsets[level] + header.levelSizes[level] > fileSize) {
+            return false;
+        }
+    }
+    return true;
+}
+
+FILE* openTextureCache(const char *cachePath, textureCacheHeader &out_header) {
+    FILE *file = fopen(cachePath, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    if (fread(&out_header, sizeof(out_header), 1, file) != 1 ||
+        memcmp(out_header.magic, "TEXC", 4) != 0 ||
+        out_header.version != TEXTURE_CACHE_VERSION) {
+        cerr << "Not a texture cache file: " << cachePath << "." << endl;
+        fclose(file);
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    if (fileSize < 0 || !validateHeader(out_header, (unsigned long long)fileSize)) {
+        cerr << "Texture cache " << cachePath << " is corrupt or truncated." << endl;
+        fclose(file);
+        return NULL;
+    }
+    return file;
+}
+
+bool loadTextureCacheLevel(FILE *file, const textureCacheHeader &header, unsigned int level, unsigned char *out_pixels) {
+    if (level >= header.levelCount) {
+        return false;
+    }
+    return fseek(file, header.levelOffsets[level], SEEK_SET) == 0 &&
+           fread(out_pixels, 1, header.levelSizes[level], file) == header.levelSizes[level];
+}
+
+GLuint loadTextureCache(const char *cachePath) {
+    textureCacheHeader header;
+    FILE *file = openTextureCache(cachePath, header);
+    if (file == NULL) {
+        return 0;
+    }
+    
+    //Level 0 is the largest, so one scratch buffer holds any of them
+    arena &scratch = scratchArena();
+    arenaScope scope(scratch);
+    unsigned char *pixels = scratch.allocateArray<unsigned char>(header.levelSizes[0]);
+    
+    GLuint texID;
+    glGenTextures(1, &texID);
+    glBindTexture(GL_TEXTURE_2D, texID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (unsigned int level = 0; level < header.levelCount; level++) {
+        if (!loadTextureCacheLevel(file, header, level, pixels)) {
+            cerr << "Texture cache " << cachePath << " is truncated." << endl;
+            break;
+        }
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGB, getMipSize(header.width, level), getMipSize(header.height, level), 0, GL_BGR, GL_UNSIGNED_BYTE, pixels);
+    }
+    fclose(file);
+    
+    //The mips came from the cache, so there's nothing to generate
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, header.levelCount - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    return texID;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstdio>
+#include <vector>
+#include "bmploader.h"
+
+//Binary texture cache: the full BGR8 mip chain of an image, generated offline, smallest level last
+//Every level can be read on its own, which is what texture streaming needs
+#define TEXTURE_CACHE_VERSION 1
+#define TEXTURE_CACHE_MAX_LEVELS 16
+
+struct textureCacheHeader {
+    char            magic[4];
+    unsigned int    version;
+    unsigned int    width;
+    unsigned int    height;
+    unsigned int    levelCount;
+    unsigned int    levelOffsets[TEXTURE_CACHE_MAX_LEVELS];
+    unsigned int    levelSizes[TEXTURE_CACHE_MAX_LEVELS];
+};
+
+//Size of a mip level, never smaller than 1x1
+int getMipSize(int size, int level);
+
+//Halves an image with a 2x2 box filter; out_image.pixels must hold getMipSize(width, 1) * getMipSize(height, 1) * 3 bytes
+void downsampleImage(const image &source, image &out_image);
+
+//Writes the image and all of its mips
+bool saveTextureCache(const char *cachePath, const image &img);
+
+//Reads just the header (the file is left open for loadTextureCacheLevel)
+FILE* openTextureCache(const char *cachePath, textureCacheHeader &out_header);
+
+//Reads one level into out_pixels, which must hold header.levelSizes[level] bytes
+bool loadTextureCacheLevel(FILE *file, const textureCacheHeader &header, unsigned int level, unsigned char *out_pixels);
+
+//Uploads every level of a cached texture as a mipmapped GL_TEXTURE_2D
+GLuint loadTextureCache(const char *cachePath);
@@ -0,0 +1,249 @@
+#include "texturepacker.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+using namespace std;
+
+/*
+ *
+ * skylinePacker
+ *
+ */
+
+skylinePacker::skylinePacker(int _width, int _height) {
+    width = _width;
+    height = _height;
+    segment ground = { 0, 0, width };
+    skyline.push_back(ground);
+}
+
+//Returns the height at which the rectangle would sit if its left edge were at the start of the given segment, or -1 if it doesn't fit there
+int skylinePacker::fit(size_t index, int rectWidth, int rectHeight) const {
+    int x = skyline[index].x;
+    if (x + rectWidth > width) {
+        return -1;
+    }
+    int y = 0;
+    int widthLeft = rectWidth;
+    for (size_t i = index; widthLeft > 0; i++) {
+        y = max(y, skyline[i].y);
+        if (y + rectHeight > height) {
+            return -1;
+        }
+        widthLeft -= skyline[i].width;
+    }
+    return y;
+}
+
+bool skylinePacker::insert(int rectWidth, int rectHeight, int &out_x, int &out_y) {
+    //Bottom-left: the spot where the top of the rectangle ends up lowest, leftmost on ties
+    size_t bestIndex = skyline.size();
+    int bestTop = height + 1;
+    for (size_t i = 0; i < skyline.size(); i++) {
+        int y = fit(i, rectWidth, rectHeight);
+        if (y >= 0 && y + rectHeight < bestTop) {
+            bestIndex = i;
+            bestTop = y + rectHeight;
+        }
+    }
+    if (bestIndex == skyline.size()) {
+        return false;
+    }
+    out_x = skyline[bestIndex].x;
+    out_y = bestTop - rectHeight;
+
+    //Raise the skyline over the new rectangle and trim the segments it now covers
+    segment raised = { out_x, bestTop, rectWidth };
+    skyline.insert(skyline.begin() + bestIndex, raised);
+    for (size_t i = bestIndex + 1; i < skyline.size(); ) {
+        int covered = skyline[i - 1].x + skyline[i - 1].width - skyline[i].x;
+        if (covered <= 0) {
+            break;
+        }
+        skyline[i].x += covered;
+        skyline[i].width -= covered;
+        if (skyline[i].width > 0) {
+            break;
+        }
+        skyline.erase(skyline.begin() + i);
+    }
+
+    //Neighbouring segments at the same height are one segment
+    for (size_t i = 1; i < skyline.size(); ) {
+        if (skyline[i - 1].y == skyline[i].y) {
+            skyline[i - 1].width += skyline[i].width;
+            skyline.erase(skyline.begin() + i);
+        }
+        else {
+            i++;
+        }
+    }
+    return true;
+}
+
+/*
+ *
+ * textureAtlasBuilder
+ *
+ */
+
+textureAtlasBuilder::textureAtlasBuilder(int _layerSize, int _mipLevels) {
+    layerSize = _layerSize;
+    mipLevels = _mipLevels;
+    layerCount = 0;
+}
+
+size_t textureAtlasBuilder::add(const image &img) {
+    sources.push_back(img);
+    sourceSize size = { img.width, img.height };
+    sourceSizes.push_back(size);
+    return sources.size() - 1;
+}
+
+//Copies the image into a layer, surrounded by a border of its own edge texels
+void textureAtlasBuilder::blit(const image &img, int layer, int x, int y) {
+    int border = (x == 0 && y == 0 && img.width == layerSize && img.height == layerSize) ? 0 : 1 << mipLevels;
+    unsigned char *destination = &layers[layer][0];
+    for (int row = -border; row < img.height + border; row++) {
+        int sourceRow = min(max(row, 0), img.height - 1);
+        for (int column = -border; column < img.width + border; column++) {
+            int sourceColumn = min(max(column, 0), img.width - 1);
+            const unsigned char *texel = img.pixels + (size_t(sourceRow) * img.width + sourceColumn) * 3;
+            unsigned char *target = destination + (size_t(y + border + row) * layerSize + (x + border + column)) * 3;
+            target[0] = texel[0];
+            target[1] = texel[1];
+            target[2] = texel[2];
+        }
+    }
+}
+
+bool textureAtlasBuilder::build() {
+    entries.assign(sources.size(), atlasEntry());
+    layers.clear();
+    layerCount = 0;
+
+    //Tallest first packs noticeably tighter than insertion order
+    vector<size_t> order(sources.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    const vector<image> &images = sources;
+    sort(order.begin(), order.end(), [&images](size_t a, size_t b) {
+        if (images[a].height != images[b].height) {
+            return images[a].height > images[b].height;
+        }
+        return images[a].width > images[b].width;
+    });
+
+    //One packer per shared layer; layerOfPacker maps it back to its layer
+    vector<skylinePacker> packers;
+    vector<int> layerOfPacker;
+    int grid = 1 << mipLevels;
+    for (size_t i = 0; i < order.size(); i++) {
+        const image &img = sources[order[i]];
+        atlasEntry &entry = entries[order[i]];
+
+        //Full-size textures get a layer to themselves, without a border
+        if (img.width == layerSize && img.height == layerSize) {
+            entry.layer = int(layers.size());
+            entry.uvTransform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+            layers.push_back(vector<unsigned char>(size_t(layerSize) * layerSize * 3, 0));
+            blit(img, entry.layer, 0, 0);
+            continue;
+        }
+
+        //Round the cell up to the grid so every texture starts on a texel boundary at each mip level we care about
+        int cellWidth = (img.width + 2 * grid + grid - 1) / grid * grid;
+        int cellHeight = (img.height + 2 * grid + grid - 1) / grid * grid;
+        if (cellWidth > layerSize || cellHeight > layerSize) {
+            cerr << "Texture of " << img.width << "x" << img.height << " is too large for a " << layerSize << "x" << layerSize << " atlas layer." << endl;
+            vector<vector<unsigned char> >().swap(layers);
+            vector<image>().swap(sources);
+            return false;
+        }
+
+        int x = 0, y = 0;
+        size_t packer = 0;
+        while (packer < packers.size() && !packers[packer].insert(cellWidth, cellHeight, x, y)) {
+            packer++;
+        }
+        if (packer == packers.size()) {
+            packers.push_back(skylinePacker(layerSize, layerSize));
+            layerOfPacker.push_back(int(layers.size()));
+            layers.push_back(vector<unsigned char>(size_t(layerSize) * layerSize * 3, 0));
+            packers.back().insert(cellWidth, cellHeight, x, y);
+        }
+
+        entry.layer = layerOfPacker[packer];
+        entry.uvTransform = glm::vec4(float(img.width) / layerSize,
+                                      float(img.height) / layerSize,
+                                      float(x + grid) / layerSize,
+                                      float(y + grid) / layerSize);
+        blit(img, entry.layer, x, y);
+    }
+    layerCount = layers.size();
+
+    //The pixels are in the layers now, and whoever owns the images may free them as soon as we return
+    vector<image>().swap(sources);
+    return true;
+}
+
+GLuint textureAtlasBuilder::upload() {
+    GLuint texID;
+    glGenTextures(1, &texID);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGB, layerSize, layerSize, GLsizei(layers.size()), 0, GL_BGR, GL_UNSIGNED_BYTE, NULL);
+    for (size_t i = 0; i < layers.size(); i++) {
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, GLint(i), layerSize, layerSize, 1, GL_BGR, GL_UNSIGNED_BYTE, &layers[i][0]);
+    }
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+    //Past this level a texel would straddle two textures
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, mipLevels);
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+    //GL has its own copy now
+    vector<vector<unsigned char> >().swap(layers);
+    return texID;
+}
+
+packingStats textureAtlasBuilder::getStats() const {
+    packingStats stats;
+    stats.textures = sourceSizes.size();
+    stats.layers = layerCount;
+    stats.contentTexels = 0;
+    for (size_t i = 0; i < sourceSizes.size(); i++) {
+        stats.contentTexels += size_t(sourceSizes[i].width) * sourceSizes[i].height;
+    }
+    stats.layerTexels = layerCount * size_t(layerSize) * layerSize;
+
+    //Drawn one texture at a time, every texture is a bind; packed, the array is bound once
+    stats.bindsBefore = sourceSizes.size();
+    stats.bindsAfter = layerCount == 0 ? 0 : 1;
+    return stats;
+}
+
+void textureAtlasBuilder::printStats() const {
+    packingStats stats = getStats();
+    printf("Packed %zu textures into %zu layers of %dx%d: %.1f%% of the texels are used\n",
+           stats.textures,
+           stats.layers,
+           layerSize,
+           layerSize,
+           stats.layerTexels > 0 ? 100.0 * stats.contentTexels / stats.layerTexels : 0.0);
+    printf("Texture binds per frame: %zu before, %zu after\n", stats.bindsBefore, stats.bindsAfter);
+}
+
+void remapUVs(vector<glm::vec2> &uvs, const atlasEntry &entry) {
+    for (size_t i = 0; i < uvs.size(); i++) {
+        uvs[i].x = uvs[i].x * entry.uvTransform.x + entry.uvTransform.z;
+        uvs[i].y = uvs[i].y * entry.uvTransform.y + entry.uvTransform.w;
+    }
+}
+
+vector<float> makeLayerAttribute(size_t vertexCount, const atlasEntry &entry) {
+    return vector<float>(vertexCount, float(entry.layer));
+}
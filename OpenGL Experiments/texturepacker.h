@@ -0,0 +1,75 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "bmploader.h"
+
+//Bottom-left skyline rectangle packer for a single page
+class skylinePacker {
+public:
+    skylinePacker(int _width, int _height);
+    bool            insert(int rectWidth, int rectHeight, int &out_x, int &out_y);
+private:
+    struct segment {
+        int x;
+        int y;
+        int width;
+    };
+    int             fit(size_t index, int rectWidth, int rectHeight) const;
+    std::vector<segment> skyline;
+    int             width;
+    int             height;
+};
+
+//Where one source texture ended up
+struct atlasEntry {
+    int             layer;
+
+    //Maps the texture's own UVs into the page: uv' = uv * (x, y) + (z, w)
+    glm::vec4       uvTransform;
+};
+
+struct packingStats {
+    size_t          textures;
+    size_t          layers;
+    size_t          contentTexels;
+    size_t          layerTexels;
+    size_t          bindsBefore;
+    size_t          bindsAfter;
+};
+
+//Packs many small textures into same-sized pages that are uploaded as the layers of one GL_TEXTURE_2D_ARRAY, so the whole scene needs a single texture binding
+//Every texture is surrounded by a border of its own edge texels and placed on a grid, both 2^mipLevels wide, so that bilinear filtering down to mip level mipLevels never reads a neighbour
+//Textures that don't fit on a page (or already fill one) get a layer of their own, which only works if they are exactly the page size
+//The pixels passed to add() only have to live until build(), which copies them into the layers; upload() then frees the layers, so each is called once
+class textureAtlasBuilder {
+public:
+    textureAtlasBuilder(int _layerSize, int _mipLevels);
+    size_t          add(const image &img);
+    bool            build();
+    GLuint          upload();
+    const atlasEntry& getEntry(size_t index) const { return entries[index]; }
+    packingStats    getStats() const;
+    void            printStats() const;
+private:
+    struct sourceSize {
+        int             width;
+        int             height;
+    };
+    void            blit(const image &img, int layer, int x, int y);
+    std::vector<image>          sources;
+    std::vector<sourceSize>     sourceSizes;
+    std::vector<atlasEntry>     entries;
+    std::vector<std::vector<unsigned char> > layers;
+    size_t          layerCount;
+    int             layerSize;
+    int             mipLevels;
+};
+
+//Rewrites UVs in place so that they address the texture's spot in the atlas
+//Only UVs inside [0, 1] stay on the texture: anything that relied on GL_REPEAT will bleed into its neighbours
+void remapUVs(std::vector<glm::vec2> &uvs, const atlasEntry &entry);
+
+//One layer index per vertex, for the attribute that selects the array layer
+std::vector<float> makeLayerAttribute(size_t vertexCount, const atlasEntry &entry);
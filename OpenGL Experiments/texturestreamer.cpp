@@ -0,0 +1,405 @@
+#include "texturestreamer.h"
+#include "texturecache.h"
+#include "memory.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+using namespace std;
+
+/*
+ *
+ * glTextureBackend
+ *
+ */
+
+GLuint glTextureBackend::createTexture(int levelCount) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+    return texture;
+}
+
+void glTextureBackend::destroyTexture(GLuint texture) {
+    glDeleteTextures(1, &texture);
+}
+
+void glTextureBackend::uploadLevel(GLuint texture, int level, int width, int height, const unsigned char *pixels) {
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, level, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, pixels);
+}
+
+void glTextureBackend::releaseLevel(GLuint texture, int level) {
+    //Respecifying the level as empty lets the driver free its storage
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, level, GL_RGB, 0, 0, 0, GL_BGR, GL_UNSIGNED_BYTE, NULL);
+}
+
+void glTextureBackend::setBaseLevel(GLuint texture, int baseLevel) {
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, baseLevel);
+}
+
+/*
+ *
+ * textureStreamer
+ *
+ */
+
+textureStreamer::textureStreamer(textureBackend &_backend, size_t _budgetBytes, int _workerCount) : backend(_backend), jobPool(sizeof(loadJob), 64, MEMORY_TEXTURE) {
+    budgetBytes = _budgetBytes;
+    residentBytes = 0;
+    reservedBytes = 0;
+    pinnedBytes = 0;
+
+    //Zero in levelLastNeeded means "never", so frames start at one
+    frameIndex = 1;
+    uploads = 0;
+    evictions = 0;
+    deniedLoads = 0;
+    loadsInFlight = 0;
+    stopping = false;
+    for (int i = 0; i < _workerCount; i++) {
+        workers.push_back(thread(&textureStreamer::runWorker, this));
+    }
+}
+
+textureStreamer::~textureStreamer() {
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueCondition.notify_all();
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+    for (size_t i = 0; i < requests.size(); i++) {
+        jobPool.release(requests[i]);
+    }
+    for (size_t i = 0; i < results.size(); i++) {
+        memoryTracker::release(results[i]->pixels, results[i]->size, MEMORY_TEXTURE);
+        jobPool.release(results[i]);
+    }
+    for (size_t i = 0; i < textures.size(); i++) {
+        backend.destroyTexture(textures[i].texture);
+    }
+}
+
+size_t textureStreamer::getLevelBytes(const streamedTexture &tex, int level) const {
+    return size_t(getMipSize(tex.width, level)) * getMipSize(tex.height, level) * STREAMING_BYTES_PER_TEXEL;
+}
+
+int textureStreamer::addTexture(const char *cachePath) {
+    textureCacheHeader header;
+    FILE *file = openTextureCache(cachePath, header);
+    if (file == NULL) {
+        cerr << "Failed to open texture cache " << cachePath << " for streaming." << endl;
+        return -1;
+    }
+
+    streamedTexture tex;
+    cachePaths.push_back(cachePath);
+    tex.cachePath = cachePaths.back().c_str();
+    tex.width = header.width;
+    tex.height = header.height;
+    tex.levelCount = header.levelCount;
+    tex.tailLevel = tex.levelCount - 1;
+    while (tex.tailLevel > 0 &&
+           getMipSize(tex.width, tex.tailLevel - 1) <= STREAMING_TAIL_SIZE &&
+           getMipSize(tex.height, tex.tailLevel - 1) <= STREAMING_TAIL_SIZE) {
+        tex.tailLevel--;
+    }
+    tex.residentLevel = tex.tailLevel;
+    tex.neededLevel = tex.levelCount - 1;
+    tex.pendingLevel = -1;
+    tex.loadFailed = false;
+    tex.levelLastNeeded.assign(tex.levelCount, 0);
+
+    //The tail is small, so it is read right here rather than going through the workers
+    arena &scratch = scratchArena();
+    arenaScope scope(scratch);
+    unsigned char *pixels = scratch.allocateArray<unsigned char>(header.levelSizes[tex.tailLevel]);
+    tex.texture = backend.createTexture(tex.levelCount);
+    size_t tailBytes = 0;
+    for (int level = tex.tailLevel; level < tex.levelCount; level++) {
+        if (!loadTextureCacheLevel(file, header, level, pixels)) {
+            cerr << "Texture cache " << cachePath << " is truncated." << endl;
+            backend.destroyTexture(tex.texture);
+            fclose(file);
+            return -1;
+        }
+        backend.uploadLevel(tex.texture, level, getMipSize(tex.width, level), getMipSize(tex.height, level), pixels);
+        tailBytes += getLevelBytes(tex, level);
+    }
+    fclose(file);
+    residentBytes += tailBytes;
+    pinnedBytes += tailBytes;
+    backend.setBaseLevel(tex.texture, tex.tailLevel);
+    if (residentBytes > budgetBytes) {
+        cerr << "The resident mip tails alone exceed the texture streaming budget." << endl;
+    }
+
+    textures.push_back(tex);
+    return int(textures.size() - 1);
+}
+
+void textureStreamer::requestLevel(int handle, float mipLevel) {
+    streamedTexture &tex = textures[handle];
+    int level = min(max(int(floor(mipLevel)), 0), tex.levelCount - 1);
+
+    //Needing a level means needing every coarser one too (trilinear filtering reads the next one down)
+    for (int i = level; i < tex.levelCount && tex.levelLastNeeded[i] != frameIndex; i++) {
+        tex.levelLastNeeded[i] = frameIndex;
+    }
+}
+
+void textureStreamer::loadLevel(loadJob &job) {
+    job.pixels = NULL;
+    job.size = 0;
+
+    textureCacheHeader header;
+    FILE *file = openTextureCache(job.cachePath, header);
+    if (file == NULL) {
+        return;
+    }
+    if (job.level < int(header.levelCount)) {
+        job.size = header.levelSizes[job.level];
+        job.pixels = static_cast<unsigned char*>(memoryTracker::allocate(job.size, MEMORY_TEXTURE));
+        if (!loadTextureCacheLevel(file, header, job.level, job.pixels)) {
+            memoryTracker::release(job.pixels, job.size, MEMORY_TEXTURE);
+            job.pixels = NULL;
+            job.size = 0;
+        }
+    }
+    fclose(file);
+}
+
+void textureStreamer::applyResult(loadJob *job) {
+    streamedTexture &tex = textures[job->handle];
+    reservedBytes -= getLevelBytes(tex, job->level);
+    if (tex.pendingLevel == job->level) {
+        tex.pendingLevel = -1;
+    }
+    if (job->pixels == NULL) {
+        cerr << "Failed to stream level " << job->level << " of " << tex.cachePath << "." << endl;
+        tex.loadFailed = true;
+    }
+
+    //Only the level right above the resident run can join it; anything else was overtaken by an eviction
+    else if (job->level == tex.residentLevel - 1) {
+        backend.uploadLevel(tex.texture, job->level, getMipSize(tex.width, job->level), getMipSize(tex.height, job->level), job->pixels);
+        backend.setBaseLevel(tex.texture, job->level);
+        tex.residentLevel = job->level;
+        residentBytes += getLevelBytes(tex, job->level);
+        uploads++;
+    }
+    memoryTracker::release(job->pixels, job->size, MEMORY_TEXTURE);
+    jobPool.release(job);
+}
+
+//Evicts least recently needed levels until the given number of bytes fits in the budget
+//Levels needed this frame, mip tails and textures with a load in flight are left alone; returns false if that isn't enough
+//Nothing is evicted for a load that gets denied, so a load that can't fit doesn't keep throwing away other textures' levels
+bool textureStreamer::makeRoom(size_t bytes) {
+    if (pinnedBytes > budgetBytes || bytes > budgetBytes - pinnedBytes) {
+        return false;
+    }
+
+    //Needing a level marks every coarser one too, so each texture's evictable levels are a run from its finest resident level up
+    size_t evictableBytes = 0;
+    for (size_t i = 0; i < textures.size(); i++) {
+        const streamedTexture &tex = textures[i];
+        if (tex.pendingLevel >= 0) {
+            continue;
+        }
+        for (int level = tex.residentLevel; level < tex.tailLevel && tex.levelLastNeeded[level] < frameIndex; level++) {
+            evictableBytes += getLevelBytes(tex, level);
+        }
+    }
+    if (residentBytes + reservedBytes + bytes > budgetBytes + evictableBytes) {
+        return false;
+    }
+
+    while (residentBytes + reservedBytes + bytes > budgetBytes) {
+        int victim = -1;
+        unsigned int oldest = frameIndex;
+        for (size_t i = 0; i < textures.size(); i++) {
+            const streamedTexture &tex = textures[i];
+            if (tex.residentLevel < tex.tailLevel && tex.pendingLevel < 0 &&
+                tex.levelLastNeeded[tex.residentLevel] < oldest) {
+                victim = int(i);
+                oldest = tex.levelLastNeeded[tex.residentLevel];
+            }
+        }
+        if (victim < 0) {
+            return false;
+        }
+
+        //Stop sampling the level before it goes away
+        streamedTexture &tex = textures[victim];
+        backend.setBaseLevel(tex.texture, tex.residentLevel + 1);
+        backend.releaseLevel(tex.texture, tex.residentLevel);
+        residentBytes -= getLevelBytes(tex, tex.residentLevel);
+        tex.residentLevel++;
+        evictions++;
+    }
+    return true;
+}
+
+void textureStreamer::update() {
+    //Upload whatever the workers finished since the last update
+    vector<loadJob*> finished;
+    {
+        lock_guard<mutex> lock(queueMutex);
+        finished.swap(results);
+    }
+    for (size_t i = 0; i < finished.size(); i++) {
+        applyResult(finished[i]);
+    }
+
+    //The finest level requested this frame; textures that weren't drawn only need their coarsest level
+    arena &frame = frameArena();
+    int *candidates = frame.allocateArray<int>(textures.size());
+    size_t candidateCount = 0;
+    for (size_t i = 0; i < textures.size(); i++) {
+        streamedTexture &tex = textures[i];
+        tex.neededLevel = tex.levelCount - 1;
+        for (int level = 0; level < tex.levelCount; level++) {
+            if (tex.levelLastNeeded[level] == frameIndex) {
+                tex.neededLevel = level;
+                break;
+            }
+        }
+        if (tex.neededLevel < tex.residentLevel && tex.pendingLevel < 0 && !tex.loadFailed) {
+            candidates[candidateCount++] = int(i);
+        }
+    }
+
+    //Whatever is furthest from the level it needs goes first, lowest handle first on ties
+    const vector<streamedTexture> &all = textures;
+    sort(candidates, candidates + candidateCount, [&all](int a, int b) {
+        int deficitA = all[a].residentLevel - all[a].neededLevel;
+        int deficitB = all[b].residentLevel - all[b].neededLevel;
+        return deficitA != deficitB ? deficitA > deficitB : a < b;
+    });
+
+    //One level per texture per update: each load can only start once the level below it is resident
+    loadJob **queued = frame.allocateArray<loadJob*>(candidateCount);
+    size_t queuedCount = 0;
+    for (size_t i = 0; i < candidateCount; i++) {
+        streamedTexture &tex = textures[candidates[i]];
+        size_t bytes = getLevelBytes(tex, tex.residentLevel - 1);
+        if (!makeRoom(bytes)) {
+            deniedLoads++;
+            continue;
+        }
+        reservedBytes += bytes;
+        tex.pendingLevel = tex.residentLevel - 1;
+        loadJob *job = static_cast<loadJob*>(jobPool.allocate());
+        job->handle = candidates[i];
+        job->level = tex.pendingLevel;
+        job->cachePath = tex.cachePath;
+        job->pixels = NULL;
+        job->size = 0;
+        queued[queuedCount++] = job;
+    }
+
+    if (workers.empty()) {
+        for (size_t i = 0; i < queuedCount; i++) {
+            loadLevel(*queued[i]);
+            applyResult(queued[i]);
+        }
+    }
+    else if (queuedCount > 0) {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            requests.insert(requests.end(), queued, queued + queuedCount);
+            loadsInFlight += queuedCount;
+        }
+        queueCondition.notify_all();
+    }
+    frameIndex++;
+}
+
+void textureStreamer::runWorker() {
+    while (true) {
+        loadJob *job;
+        {
+            unique_lock<mutex> lock(queueMutex);
+            queueCondition.wait(lock, [this] { return stopping || !requests.empty(); });
+            if (stopping) {
+                return;
+            }
+            job = requests.front();
+            requests.pop_front();
+        }
+
+        //The file read is the slow part, and the only part that happens off the main thread
+        loadLevel(*job);
+        {
+            lock_guard<mutex> lock(queueMutex);
+            results.push_back(job);
+            loadsInFlight--;
+        }
+        queueCondition.notify_all();
+    }
+}
+
+void textureStreamer::waitForLoads() {
+    unique_lock<mutex> lock(queueMutex);
+    queueCondition.wait(lock, [this] { return loadsInFlight == 0; });
+}
+
+streamingStats textureStreamer::getStats() const {
+    streamingStats stats;
+    stats.textures = textures.size();
+    stats.residentBytes = residentBytes;
+    stats.budgetBytes = budgetBytes;
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stats.pendingLoads = loadsInFlight + results.size();
+    }
+    stats.uploads = uploads;
+    stats.evictions = evictions;
+    stats.deniedLoads = deniedLoads;
+    return stats;
+}
+
+void textureStreamer::printStats() const {
+    streamingStats stats = getStats();
+    printf("Streaming %zu textures: %.1f of %.1f MB resident, %zu loads pending\n",
+           stats.textures,
+           stats.residentBytes / (1024.0 * 1024.0),
+           stats.budgetBytes / (1024.0 * 1024.0),
+           stats.pendingLoads);
+    printf("%zu levels streamed in, %zu evicted, %zu loads denied by the budget\n", stats.uploads, stats.evictions, stats.deniedLoads);
+}
+
+float computeUVDensity(const vector<glm::vec3> &positions, const vector<glm::vec2> &uvs) {
+    float uvArea = 0.0f;
+    float worldArea = 0.0f;
+    for (size_t i = 0; i + 2 < positions.size() && i + 2 < uvs.size(); i += 3) {
+        glm::vec2 uvEdge0 = uvs[i + 1] - uvs[i];
+        glm::vec2 uvEdge1 = uvs[i + 2] - uvs[i];
+        uvArea += 0.5f * fabs(uvEdge0.x * uvEdge1.y - uvEdge0.y * uvEdge1.x);
+        worldArea += 0.5f * glm::length(glm::cross(positions[i + 1] - positions[i], positions[i + 2] - positions[i]));
+    }
+    return worldArea > 0.0f ? uvArea / worldArea : 0.0f;
+}
+
+float estimateMipLevel(int width, int height, float uvDensity, float distance, float projectionScale, int viewportHeight) {
+    //The world-space size of one pixel at that distance, then how many texels land on it
+    float pixelSize = 2.0f * distance / (projectionScale * viewportHeight);
+    float texelsPerPixel = uvDensity * width * height * pixelSize * pixelSize;
+    if (texelsPerPixel <= 0.0f) {
+        return 0.0f;
+    }
+
+    //Texels per pixel is an area, so each mip level divides it by four
+    return 0.5f * log2(texelsPerPixel);
+}
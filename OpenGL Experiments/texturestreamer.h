@@ -0,0 +1,143 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "memory.h"
+
+//Levels whose width and height are both at most this are loaded when a texture is added and are never evicted, so every texture can always be drawn
+#define STREAMING_TAIL_SIZE 64
+
+//What the budget charges per texel: drivers store GL_RGB8 padded out to four bytes
+#define STREAMING_BYTES_PER_TEXEL 4
+
+//Everything the streamer asks of the graphics API
+//The residency logic only talks to this, so it can be driven by a mock backend that just records the calls
+class textureBackend {
+public:
+    virtual ~textureBackend() {}
+    virtual GLuint  createTexture(int levelCount) = 0;
+    virtual void    destroyTexture(GLuint texture) = 0;
+
+    //Pixels are tightly packed BGR8, as stored in the texture cache
+    virtual void    uploadLevel(GLuint texture, int level, int width, int height, const unsigned char *pixels) = 0;
+    virtual void    releaseLevel(GLuint texture, int level) = 0;
+
+    //Only levels from baseLevel on may be sampled
+    virtual void    setBaseLevel(GLuint texture, int baseLevel) = 0;
+};
+
+//OpenGL 3.2 has no sparse textures, so a level is released by respecifying it as 0x0 and kept out of sampling with GL_TEXTURE_BASE_LEVEL
+class glTextureBackend : public textureBackend {
+public:
+    GLuint          createTexture(int levelCount);
+    void            destroyTexture(GLuint texture);
+    void            uploadLevel(GLuint texture, int level, int width, int height, const unsigned char *pixels);
+    void            releaseLevel(GLuint texture, int level);
+    void            setBaseLevel(GLuint texture, int baseLevel);
+};
+
+struct streamingStats {
+    size_t          textures;
+    size_t          residentBytes;
+    size_t          budgetBytes;
+    size_t          pendingLoads;
+    size_t          uploads;
+    size_t          evictions;
+    size_t          deniedLoads;
+};
+
+//Streams the mip levels of texture cache files (see texturecache.h) in and out under a fixed memory budget
+//Each texture keeps a contiguous run of levels resident, from its finest resident level down to 1x1; streaming in adds the next finer level, evicting drops the finest one
+//Every frame, call requestLevel() for each visible draw with the level it needs (see estimateMipLevel), then update() once
+//update() uploads whatever the workers finished, evicts the least recently needed levels to make room, and queues the next loads
+//With no worker threads the loads run inside update(), which keeps the behaviour deterministic for tests
+//Everything but the workers runs on the thread that owns the GL context, and update() takes its per-frame lists from frameArena()
+class textureStreamer {
+public:
+    textureStreamer(textureBackend &_backend, size_t _budgetBytes, int _workerCount);
+    ~textureStreamer();
+
+    //Loads the tail of the mip chain and returns a handle, or -1 if the cache file can't be read
+    int             addTexture(const char *cachePath);
+    GLuint          getTexture(int handle) const { return textures[handle].texture; }
+    int             getWidth(int handle) const { return textures[handle].width; }
+    int             getHeight(int handle) const { return textures[handle].height; }
+    int             getResidentLevel(int handle) const { return textures[handle].residentLevel; }
+    int             getNeededLevel(int handle) const { return textures[handle].neededLevel; }
+    void            requestLevel(int handle, float mipLevel);
+    void            update();
+
+    //Blocks until every queued load has finished; only meant for shutdown and tests
+    void            waitForLoads();
+    streamingStats  getStats() const;
+    void            printStats() const;
+private:
+    struct streamedTexture {
+        const char*     cachePath;
+        GLuint          texture;
+        int             width;
+        int             height;
+        int             levelCount;
+        int             tailLevel;
+        int             residentLevel;
+        int             neededLevel;
+        int             pendingLevel;
+        bool            loadFailed;
+
+        //Frame in which each level was last needed, for the LRU
+        std::vector<unsigned int> levelLastNeeded;
+    };
+    //One level on its way in: taken from jobPool on the main thread, filled in by a worker and given back by applyResult()
+    struct loadJob {
+        int             handle;
+        int             level;
+        const char*     cachePath;
+        unsigned char*  pixels;
+        size_t          size;
+    };
+    textureStreamer(const textureStreamer&);
+    textureStreamer& operator=(const textureStreamer&);
+    size_t          getLevelBytes(const streamedTexture &tex, int level) const;
+    static void     loadLevel(loadJob &job);
+    void            applyResult(loadJob *job);
+    bool            makeRoom(size_t bytes);
+    void            runWorker();
+    textureBackend& backend;
+    std::vector<streamedTexture> textures;
+
+    //A deque never moves its elements, so textures and jobs can point into it
+    std::deque<std::string> cachePaths;
+    poolAllocator   jobPool;
+    size_t          budgetBytes;
+    size_t          residentBytes;
+    size_t          reservedBytes;
+
+    //The part of residentBytes taken by the mip tails, which can never be evicted
+    size_t          pinnedBytes;
+    unsigned int    frameIndex;
+    size_t          uploads;
+    size_t          evictions;
+    size_t          deniedLoads;
+
+    //Shared with the workers
+    std::vector<std::thread> workers;
+    mutable std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    std::deque<loadJob*> requests;
+    std::vector<loadJob*> results;
+    size_t          loadsInFlight;
+    bool            stopping;
+};
+
+//UV area per unit of world-space surface area over a (non-indexed) triangle list; a property of the mesh, so compute it once
+float computeUVDensity(const std::vector<glm::vec3> &positions, const std::vector<glm::vec2> &uvs);
+
+//The mip level that puts about one texel on one pixel for a surface at the given distance
+//projectionScale is projection[1][1] and viewportHeight is in pixels; the result is not clamped to the levels the texture has
+float estimateMipLevel(int width, int height, float uvDensity, float distance, float projectionScale, int viewportHeight);
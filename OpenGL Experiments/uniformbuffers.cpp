@@ -0,0 +1,92 @@
+#include "uniformbuffers.h"
+#include <iostream>
+
+using namespace std;
+
+void bindUniformBlocks(GLuint program) {
+    GLuint cameraIndex = glGetUniformBlockIndex(program, "Camera");
+    if (cameraIndex != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, cameraIndex, CAMERA_BLOCK_BINDING);
+    }
+    GLuint objectIndex = glGetUniformBlockIndex(program, "Objects");
+    if (objectIndex != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, objectIndex, OBJECT_BLOCK_BINDING);
+    }
+}
+
+/*
+ *
+ * cameraBuffer
+ *
+ */
+
+cameraBuffer::cameraBuffer() {
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(cameraData), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+cameraBuffer::~cameraBuffer() {
+    glDeleteBuffers(1, &buffer);
+}
+
+void cameraBuffer::update(const glm::mat4 &view, const glm::mat4 &projection, const glm::vec3 &position) {
+    cameraData data;
+    data.view = view;
+    data.projection = projection;
+    data.viewProjection = projection * view;
+    data.position = glm::vec4(position, 1.0f);
+
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(cameraData), &data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+/*
+ *
+ * objectBuffer
+ *
+ */
+
+objectBuffer::objectBuffer(size_t _capacity) {
+    //bindObjects() can only start a window at a multiple of the implementation's offset alignment
+    GLint offsetAlignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+    objectAlignment = (size_t(offsetAlignment) + sizeof(objectData) - 1) / sizeof(objectData);
+
+    //Leave room past the last object so that a window starting near the end is still a full block
+    objects.resize(_capacity + OBJECTS_PER_BLOCK, objectData());
+    for (size_t i = 0; i < objects.size(); i++) {
+        objects[i].model = glm::mat4(1.0f);
+    }
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, objects.size() * sizeof(objectData), &objects[0], GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    bindObjects(0);
+}
+
+objectBuffer::~objectBuffer() {
+    glDeleteBuffers(1, &buffer);
+}
+
+void objectBuffer::setModel(size_t index, const glm::mat4 &model) {
+    objects[index].model = model;
+}
+
+void objectBuffer::upload() {
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, objects.size() * sizeof(objectData), &objects[0]);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void objectBuffer::bindObjects(size_t firstObject) {
+    if (firstObject % objectAlignment != 0) {
+        cerr << "Object " << firstObject << " is not a multiple of the uniform buffer offset alignment (" << objectAlignment << " objects)." << endl;
+        return;
+    }
+    glBindBufferRange(GL_UNIFORM_BUFFER, OBJECT_BLOCK_BINDING, buffer, firstObject * sizeof(objectData), OBJECTS_PER_BLOCK * sizeof(objectData));
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+//Binding points shared by every program: bindUniformBlocks() hooks a program's blocks up to these
+#define CAMERA_BLOCK_BINDING 0
+#define OBJECT_BLOCK_BINDING 1
+
+//How many objects one "Objects" block holds: 256 model matrices are exactly the 16KB every implementation must support
+#define OBJECTS_PER_BLOCK 256
+
+//Matches the std140 "Camera" block in the shaders
+struct cameraData {
+    glm::mat4       view;
+    glm::mat4       projection;
+    glm::mat4       viewProjection;
+    glm::vec4       position;
+};
+
+//Matches the std140 ObjectData struct in the shaders
+struct objectData {
+    glm::mat4       model;
+};
+
+//Looks up the "Camera" and "Objects" blocks of a program (either may be missing) and points them at the shared binding points
+//GLSL 3.30 can't declare the binding in the shader, so call this once after loading every program
+void bindUniformBlocks(GLuint program);
+
+//The camera matrices, uploaded once per frame and read by every program
+class cameraBuffer {
+public:
+    cameraBuffer();
+    ~cameraBuffer();
+    void            update(const glm::mat4 &view, const glm::mat4 &projection, const glm::vec3 &position);
+private:
+    cameraBuffer(const cameraBuffer&);
+    cameraBuffer&   operator=(const cameraBuffer&);
+    GLuint          buffer;
+};
+
+//Per-object data for every object in the scene, indexed in the shader by gl_InstanceID
+//Each draw sees a window of OBJECTS_PER_BLOCK objects starting at the one passed to bindObjects()
+class objectBuffer {
+public:
+    objectBuffer(size_t _capacity);
+    ~objectBuffer();
+    void            setModel(size_t index, const glm::mat4 &model);
+    void            upload();
+    void            bindObjects(size_t firstObject);
+    size_t          getObjectAlignment() const { return objectAlignment; }
+private:
+    objectBuffer(const objectBuffer&);
+    objectBuffer&   operator=(const objectBuffer&);
+    std::vector<objectData> objects;
+    GLuint          buffer;
+    size_t          objectAlignment;
+};